@@ -0,0 +1,80 @@
+#include <algorithm>
+
+#include <pleb/pleb.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	Admission control.
+		First, the cost of the admission check on an unsaturated service.
+		Then an overloaded service: 16 threads request work taking 100us each,
+		without limits and with a concurrency limit of 2 and a queue of 4.
+		Reports latency of accepted requests and how quickly rejections return.
+*/
+
+
+namespace
+{
+	void busy_work(std::chrono::microseconds duration)
+	{
+		auto until = bench::clock::now() + duration;
+		while (bench::clock::now() < until) {}
+	}
+
+	void bench_admission()
+	{
+		{
+			const size_t requests = 1000000;
+			pleb::topic topic("bench/admission/cheap");
+			auto svc = topic.serve([](pleb::request &r) {r.respond_OK(1);});
+
+			bench::time("GET, no limits", requests, [&]
+			{
+				for (size_t i = 0; i < requests; ++i) (void) topic.GET().await<int>();
+			});
+			svc->set_limits({64, 64});
+			bench::time("GET, limits never reached", requests, [&]
+			{
+				for (size_t i = 0; i < requests; ++i) (void) topic.GET().await<int>();
+			});
+		}
+
+		const size_t threads = 16, per_thread = 200;
+		for (bool limited : {false, true})
+		{
+			pleb::topic topic("bench/admission/overloaded");
+			auto svc = topic.serve([](pleb::request &r) {busy_work(std::chrono::microseconds(100)); r.respond_OK(1);});
+			if (limited) svc->set_limits({2, 4});
+
+			std::vector<double>      accepted, rejected;
+			std::mutex               mutex;
+			std::vector<std::thread> requesters;
+			for (size_t t = 0; t < threads; ++t) requesters.emplace_back([&]
+			{
+				std::vector<double> a, r;
+				for (size_t i = 0; i < per_thread; ++i)
+				{
+					auto begin = bench::clock::now();
+					pleb::response response = topic.GET();
+					double us = std::chrono::duration<double, std::micro>(bench::clock::now() - begin).count();
+					(response.status().isSuccess() ? a : r).push_back(us);
+				}
+				std::lock_guard<std::mutex> lock(mutex);
+				accepted.insert(accepted.end(), a.begin(), a.end());
+				rejected.insert(rejected.end(), r.begin(), r.end());
+			});
+			for (auto &t : requesters) t.join();
+
+			std::sort(accepted.begin(), accepted.end());
+			std::sort(rejected.begin(), rejected.end());
+			auto pct = [](const std::vector<double> &v, double p) {return v.empty() ? 0.0 : v[std::min(v.size() - 1, size_t(p * v.size()))];};
+
+			std::cout << "  " << (limited ? "concurrency 2, queue 4" : "no limits") << std::fixed << std::setprecision(0)
+				<< ": " << accepted.size() << " accepted, p50 " << pct(accepted, 0.5) << "us, p99 " << pct(accepted, 0.99) << "us; "
+				<< rejected.size() << " rejected, p50 " << pct(rejected, 0.5) << "us" << std::endl;
+		}
+	}
+
+	bench::registration reg("admission", &bench_admission);
+}
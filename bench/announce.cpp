@@ -0,0 +1,60 @@
+#include <string>
+#include <vector>
+
+#include <pleb/pleb.hpp>
+#include <pleb/discover.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	Registering and releasing many subscriptions at startup, with and
+		without a discovery subscription watching for new receivers.
+*/
+
+
+namespace
+{
+	void bench_announce()
+	{
+		const size_t receivers = 100000, topics = 1000;
+
+		std::vector<pleb::topic> paths;
+		for (size_t i = 0; i < topics; ++i) paths.emplace_back("bench/announce/" + std::to_string(i));
+
+		std::vector<pleb::subscription_ptr> subs;
+		subs.reserve(receivers);
+		auto subscribe_all = [&]
+		{
+			for (size_t i = 0; i < receivers; ++i) subs.push_back(paths[i % topics].subscribe([](const pleb::event&) {}));
+		};
+		auto release_all = [&] {subs.clear();};
+
+		bench::time("subscribe, nothing discovering", receivers, subscribe_all);
+		bench::time("release, nothing discovering", receivers, release_all);
+
+		size_t found = 0;
+		auto watch = pleb::discover_subscriptions([&](const pleb::subscription_ptr&) {++found;}, pleb::topic("bench/announce"));
+
+		bench::time("subscribe, discovered one by one", receivers, subscribe_all);
+		bench::time("release, discovered", receivers, release_all);
+
+		bench::time("subscribe, discovered in a batch", receivers, [&]
+		{
+			pleb::announcement_batch batch;
+			subscribe_all();
+		});
+		release_all();
+
+		bench::time("subscribe, announcements suppressed", receivers, [&]
+		{
+			pleb::announcement_batch batch(pleb::announcement_batch::suppress);
+			subscribe_all();
+		});
+		release_all();
+
+		if (found != 2 * receivers + 2) std::cout << "  (discovered " << found << ")" << std::endl;
+	}
+
+	bench::registration reg("announce", &bench_announce);
+}
@@ -0,0 +1,74 @@
+#include <pleb/pleb.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	Issuing many POSTs to a handful of topics, individually and in batches.
+*/
+
+
+namespace
+{
+	void bench_batch()
+	{
+		const size_t topics = 4, per_tick = 10000, ticks = 20;
+		const size_t total = per_tick * ticks;
+
+		std::vector<pleb::topic_path> paths;
+		for (size_t t = 0; t < topics; ++t) paths.emplace_back("bench/batch/ingest/" + std::to_string(t));
+
+		size_t sum = 0;
+		auto single = [&](pleb::request &r) {sum += *r.get<int>();};
+		auto batched = [&](std::span<pleb::request> b) {for (auto &r : b) sum += *r.get<int>();};
+
+		// Requests arrive interleaved across topics, or already grouped by topic.
+		auto fill = [&](std::vector<pleb::request> &requests, bool grouped = false)
+		{
+			requests.clear();
+			for (size_t i = 0; i < per_tick; ++i)
+				requests.emplace_back(nullptr, paths[grouped ? (i * topics / per_tick) : (i % topics)], pleb::method::POST, int(i));
+		};
+
+		{
+			std::vector<pleb::service_ptr> services;
+			for (auto &p : paths) services.push_back(p.serve(single));
+
+			bench::time("individual POST", total, [&]
+			{
+				for (size_t t = 0; t < ticks; ++t)
+					for (size_t i = 0; i < per_tick; ++i) paths[i % topics].POST(int(i));
+			});
+
+			std::vector<pleb::request> requests;
+			requests.reserve(per_tick);
+			bench::time("constructing requests only", total, [&]
+			{
+				for (size_t t = 0; t < ticks; ++t) fill(requests);
+			});
+			bench::time("issue_batch, per-request services", total, [&]
+			{
+				for (size_t t = 0; t < ticks; ++t) {fill(requests); pleb::issue_batch(requests);}
+			});
+		}
+		{
+			std::vector<pleb::service_ptr> services;
+			for (auto &p : paths) services.push_back(p.serve_batch(batched));
+
+			std::vector<pleb::request> requests;
+			requests.reserve(per_tick);
+			bench::time("issue_batch, batch services, interleaved", total, [&]
+			{
+				for (size_t t = 0; t < ticks; ++t) {fill(requests); pleb::issue_batch(requests);}
+			});
+			bench::time("issue_batch, batch services, grouped", total, [&]
+			{
+				for (size_t t = 0; t < ticks; ++t) {fill(requests, true); pleb::issue_batch(requests);}
+			});
+		}
+
+		if (!sum) std::cout << "  (no requests handled)" << std::endl;
+	}
+
+	bench::registration reg("batch", &bench_batch);
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <chrono>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <string_view>
+
+
+/*
+	A minimal benchmark harness for PLEB.
+		Each source file in this directory registers one or more benchmarks,
+		which are run by name (or all together) from main.cpp.
+*/
+
+
+namespace bench
+{
+	using clock = std::chrono::steady_clock;
+
+	struct entry
+	{
+		const char *name;
+		void      (*run)();
+	};
+
+	inline std::vector<entry> &registry()    {static std::vector<entry> r; return r;}
+
+	// Register a benchmark at static initialization time.
+	struct registration
+	{
+		registration(const char *name, void (*run)())    {registry().push_back({name, run});}
+	};
+
+
+	// Print a timing result as nanoseconds per operation.
+	inline void report(std::string_view label, size_t operations, clock::duration elapsed)
+	{
+		double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+		std::cout << "  " << std::left << std::setw(48) << label << std::right
+			<< std::setw(12) << std::fixed << std::setprecision(1) << (ns / operations) << " ns/op"
+			<< std::setw(14) << size_t(operations / (ns * 1e-9)) << " op/s" << std::endl;
+	}
+
+	// Time a functor and report the result.
+	template<typename Functor>
+	clock::duration time(std::string_view label, size_t operations, Functor &&functor)
+	{
+		auto start = clock::now();
+		functor();
+		auto elapsed = clock::now() - start;
+		report(label, operations, elapsed);
+		return elapsed;
+	}
+}
@@ -0,0 +1,64 @@
+#include <pleb/pleb.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	Abandoned requests to a service which claims each client and does
+		about 200us of work for it on the default executor, as a long-poll
+		service might.  One requester in five drops its future right away.
+		A service which checks is_cancelled() between chunks stops early.
+*/
+
+
+namespace
+{
+	void busy_work(std::chrono::microseconds duration)
+	{
+		auto until = bench::clock::now() + duration;
+		while (bench::clock::now() < until) {}
+	}
+
+	void bench_cancellation()
+	{
+		const size_t requests = 2000, chunks = 10;
+
+		for (bool honor : {false, true})
+		{
+			std::atomic<size_t> worked = 0, running = 0;
+			pleb::topic topic("bench/cancellation/poll");
+			auto svc = topic.serve([&, honor](pleb::request &r)
+			{
+				++running;
+				pleb::default_executor().post([&, honor, client = r.claim_client(), topic = r.topic]
+				{
+					for (size_t i = 0; i < chunks; ++i)
+					{
+						if (honor && client->is_cancelled()) break;
+						busy_work(std::chrono::microseconds(20));
+						++worked;
+					}
+					client->respond(topic, pleb::statuses::OK, int(worked));
+					--running;
+				});
+			});
+
+			bench::time(honor ? "service checks is_cancelled()" : "service ignores cancellation", requests, [&]
+			{
+				std::vector<pleb::future<int>> kept;
+				for (size_t i = 0; i < requests; ++i)
+				{
+					pleb::future<int> f = topic.GET();
+					if (i % 5) kept.push_back(std::move(f));
+				}
+				for (auto &f : kept) f.wait();
+
+				// Let any abandoned work drain before the service is released.
+				while (running) std::this_thread::yield();
+			});
+			std::cout << "    " << worked << " of " << requests * chunks << " chunks of work done" << std::endl;
+		}
+	}
+
+	bench::registration reg("cancellation", &bench_cancellation);
+}
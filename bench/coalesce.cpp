@@ -0,0 +1,72 @@
+#include <barrier>
+#include <algorithm>
+
+#include <pleb/pleb.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	A thundering herd of identical GETs, with and without flags::coalescing.
+		Each round, every thread issues one GET at the same moment to a
+		service that waits 1ms on a simulated backend and then does about
+		100us of work.  Reports how many times the service ran and the
+		latency distribution seen by the requesters.
+*/
+
+
+namespace
+{
+	void busy_work(std::chrono::microseconds duration)
+	{
+		auto until = bench::clock::now() + duration;
+		while (bench::clock::now() < until) {}
+	}
+
+	void herd(const char *label, pleb::service_config config)
+	{
+		const size_t threads = 64, rounds = 20;
+
+		std::atomic<size_t> invocations = 0;
+		pleb::topic topic("bench/coalesce/hot");
+		auto svc = topic.serve([&](pleb::request &r)
+		{
+			++invocations;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			busy_work(std::chrono::microseconds(100));
+			r.respond_OK(42);
+		}, config);
+
+		std::vector<double> latencies(threads * rounds);
+		std::barrier        start(threads);
+		std::vector<std::thread> requesters;
+		for (size_t t = 0; t < threads; ++t) requesters.emplace_back([&, t]
+		{
+			for (size_t round = 0; round < rounds; ++round)
+			{
+				start.arrive_and_wait();
+				auto begin = bench::clock::now();
+				(void) topic.GET().await<int>();
+				latencies[round * threads + t] = std::chrono::duration<double, std::micro>(bench::clock::now() - begin).count();
+			}
+		});
+		for (auto &t : requesters) t.join();
+
+		std::sort(latencies.begin(), latencies.end());
+		auto pct = [&](double p) {return latencies[std::min(latencies.size() - 1, size_t(p * latencies.size()))];};
+
+		std::cout << "  " << std::left << std::setw(20) << label << std::right << std::fixed << std::setprecision(0)
+			<< std::setw(6) << invocations << " invocations for " << latencies.size() << " requests;"
+			<< "  p50 " << std::setw(6) << pct(0.50) << "us"
+			<< "  p99 " << std::setw(6) << pct(0.99) << "us"
+			<< "  max " << std::setw(6) << latencies.back() << "us" << std::endl;
+	}
+
+	void bench_coalesce()
+	{
+		herd("ordinary service",   {});
+		herd("coalescing service", pleb::flags::coalescing);
+	}
+
+	bench::registration reg("coalesce", &bench_coalesce);
+}
@@ -0,0 +1,62 @@
+#include <pleb/pleb.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	A UI showing 5000 meters.  Each frame, every meter is updated 16 times,
+		as at 1kHz with a 60Hz display, and then the UI thread catches up.
+		Compares queued subscriptions, which deliver every update, with
+		latest-value subscriptions drained through a conflation_group.
+*/
+
+
+namespace
+{
+	void bench_conflation()
+	{
+		const size_t meters = 5000, updates = 16, frames = 10;
+
+		std::vector<pleb::topic> topics;
+		for (size_t i = 0; i < meters; ++i) topics.emplace_back("bench/conflation/meter/" + std::to_string(i));
+
+		for (bool latest : {false, true})
+		{
+			double shown = 0;
+			auto   draw  = [&](const pleb::event &e) {shown += *e.get<double>();};
+
+			auto group = std::make_shared<pleb::conflation_group>();
+			std::vector<std::shared_ptr<pleb::queued_subscription>> queued;
+			std::vector<std::shared_ptr<pleb::latest_subscription>> newest;
+			for (auto &t : topics)
+			{
+				if (latest) newest.push_back(t.subscribe_latest(draw, group));
+				else        queued.push_back(t.subscribe_queued(draw, {updates, pleb::overflow_policy::drop_oldest, true}));
+			}
+
+			bench::clock::duration publishing = {}, consuming = {};
+			size_t                 delivered  = 0;
+			for (size_t f = 0; f < frames; ++f)
+			{
+				auto begin = bench::clock::now();
+				for (size_t u = 0; u < updates; ++u)
+					for (auto &t : topics) t.publish(pleb::statuses::OK, double(u));
+				auto middle = bench::clock::now();
+
+				if (latest) delivered += group->drain();
+				else for (auto &q : queued) delivered += q->drain();
+				auto end = bench::clock::now();
+
+				publishing += middle - begin;
+				consuming  += end - middle;
+			}
+
+			std::cout << "  " << (latest ? "latest, conflation_group" : "queued, every event") << std::fixed << std::setprecision(0)
+				<< ": publish " << std::chrono::duration<double, std::nano>(publishing).count() / (frames * updates * meters)
+				<< " ns/event; UI frame " << std::chrono::duration<double, std::micro>(consuming).count() / frames
+				<< " us for " << delivered / frames << " events" << std::endl;
+		}
+	}
+
+	bench::registration reg("conflation", &bench_conflation);
+}
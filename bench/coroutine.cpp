@@ -0,0 +1,105 @@
+#include <pleb/pleb.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	Coroutine requests compared with std::future and blocking await.
+		Everything runs on a single thread.  The deferred service parks
+		clients in a queue which is drained after all requests are issued,
+		so up to `concurrent` requests are outstanding at once.
+*/
+
+
+namespace
+{
+	struct deferred_queue
+	{
+		std::vector<std::pair<pleb::client_ptr, pleb::topic_path>> pending;
+
+		void drain()
+		{
+			for (auto &p : pending)
+			{
+				auto client = std::move(p.first);
+				client->respond(p.second, pleb::statuses::OK, 1);
+			}
+			pending.clear();
+		}
+	};
+
+	pleb::task<void> coroutine_request(pleb::topic topic, int &sum)
+	{
+		sum += co_await pleb::awaitable<int>(topic.GET());
+	}
+
+
+	void bench_coroutine()
+	{
+		const size_t requests = 200000, concurrent = 10000;
+
+		pleb::topic inline_topic("bench/coroutine/inline"), deferred_topic("bench/coroutine/deferred");
+		deferred_queue queue;
+		queue.pending.reserve(concurrent);
+
+		auto svc_inline   = inline_topic  .serve([](pleb::request &r) {r.respond_OK(1);});
+		auto svc_deferred = deferred_topic.serve([&](pleb::request &r) {queue.pending.emplace_back(r.claim_client(), r.topic);});
+
+		int sum = 0;
+
+		std::cout << " inline service:" << std::endl;
+		bench::time("std::future (async().get())", requests, [&]
+		{
+			for (size_t i = 0; i < requests; ++i) sum += inline_topic.GET().async<int>().get();
+		});
+		bench::time("blocking await<int>()", requests, [&]
+		{
+			for (size_t i = 0; i < requests; ++i) sum += inline_topic.GET().await<int>();
+		});
+		bench::time("co_await (completes without suspending)", requests, [&]
+		{
+			for (size_t i = 0; i < requests; ++i) coroutine_request(inline_topic, sum).start();
+		});
+
+		std::cout << " deferred service, " << concurrent << " outstanding:" << std::endl;
+		bench::time("std::future", requests, [&]
+		{
+			std::vector<std::future<int>> futures;
+			futures.reserve(concurrent);
+			for (size_t done = 0; done < requests; done += concurrent)
+			{
+				for (size_t i = 0; i < concurrent; ++i) futures.push_back(deferred_topic.GET().async<int>());
+				queue.drain();
+				for (auto &f : futures) sum += f.get();
+				futures.clear();
+			}
+		});
+		bench::time("pleb::future", requests, [&]
+		{
+			std::vector<pleb::future<int>> futures;
+			futures.reserve(concurrent);
+			for (size_t done = 0; done < requests; done += concurrent)
+			{
+				for (size_t i = 0; i < concurrent; ++i) futures.push_back(deferred_topic.GET().send<int>());
+				queue.drain();
+				for (auto &f : futures) sum += f.get();
+				futures.clear();
+			}
+		});
+		bench::time("co_await (resumed by responder)", requests, [&]
+		{
+			std::vector<pleb::task<void>> tasks;
+			tasks.reserve(concurrent);
+			for (size_t done = 0; done < requests; done += concurrent)
+			{
+				for (size_t i = 0; i < concurrent; ++i) {tasks.push_back(coroutine_request(deferred_topic, sum)); tasks.back().start();}
+				queue.drain();
+				tasks.clear();
+			}
+		});
+
+		if (sum != int(6*requests)) std::cout << "  (unexpected sum " << sum << ")" << std::endl;
+	}
+
+	bench::registration reg("coroutine", &bench_coroutine);
+}
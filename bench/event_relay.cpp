@@ -0,0 +1,49 @@
+#include <vector>
+
+#include <pleb/pleb.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	Events forwarded through a chain of relays to one subscriber.
+		Each event carries 16KB of samples, as a sensor bus might.
+		Compares relays which republish a copy of each event, as
+		forward_events once did, with forward_events in both modes.
+*/
+
+
+namespace
+{
+	void bench_event_relay()
+	{
+		const size_t events = 200000, hops = 3;
+		const std::vector<int> samples(4096, 7);
+
+		size_t received = 0;
+		auto sink = pleb::subscribe("bench/event_relay/r3", [&](const pleb::event &e) {received += e.get<std::vector<int>>()->size();});
+
+		for (int mode = 0; mode < 3; ++mode)
+		{
+			std::vector<pleb::subscription_ptr> relays;
+			for (size_t i = 0; i < hops; ++i)
+			{
+				pleb::topic      from("bench/event_relay/r" + std::to_string(i));
+				pleb::topic_path to  ("bench/event_relay/r" + std::to_string(i + 1));
+
+				if (mode == 0) relays.push_back(from.subscribe([to](const pleb::event &e) {to.publish(e.status(), e.value(), pleb::message_flags(e.filtering, e.requirements));}));
+				else relays.push_back(from.forward_events(to, {}, mode == 1 ? pleb::event_forwarding::original_topic : pleb::event_forwarding::destination_topic));
+			}
+
+			const char *label[] = {"republishing copies", "forward_events, original topic", "forward_events, destination topic"};
+			pleb::event event("bench/event_relay/r0", pleb::statuses::OK, samples);
+			bench::time(label[mode], events, [&]
+			{
+				for (size_t i = 0; i < events; ++i) event.publish();
+			});
+		}
+		if (received != 3 * events * samples.size()) std::cout << "  (events were lost)" << std::endl;
+	}
+
+	bench::registration reg("event_relay", &bench_event_relay);
+}
@@ -0,0 +1,149 @@
+#include <mutex>
+#include <deque>
+#include <condition_variable>
+#include <functional>
+
+#include <pleb/pleb.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	Executor throughput compared with a naive mutex-protected queue.
+		"flat" posts every job from the main thread.
+		"fork" has jobs post further jobs, as nested fan-out does.
+*/
+
+
+namespace
+{
+	// The thread pool everybody writes first.
+	class mutex_pool
+	{
+	public:
+		explicit mutex_pool(size_t threads)
+		{
+			for (size_t i = 0; i < threads; ++i) _threads.emplace_back([this]() {_work();});
+		}
+		~mutex_pool()
+		{
+			{std::lock_guard<std::mutex> lock(_mutex); _stopping = true;}
+			_cv.notify_all();
+			for (auto &t : _threads) t.join();
+		}
+
+		template<typename F>
+		void post(F &&f)
+		{
+			{std::lock_guard<std::mutex> lock(_mutex); _jobs.emplace_back(std::forward<F>(f));}
+			_cv.notify_one();
+		}
+
+	private:
+		std::mutex                        _mutex;
+		std::condition_variable           _cv;
+		std::deque<std::function<void()>> _jobs;
+		std::vector<std::thread>          _threads;
+		bool                              _stopping = false;
+
+		void _work()
+		{
+			while (true)
+			{
+				std::function<void()> job;
+				{
+					std::unique_lock<std::mutex> lock(_mutex);
+					_cv.wait(lock, [this]() {return _stopping || !_jobs.empty();});
+					if (_jobs.empty()) return;
+					job = std::move(_jobs.front());
+					_jobs.pop_front();
+				}
+				job();
+			}
+		}
+	};
+
+
+	struct countdown
+	{
+		std::atomic<size_t> remaining;
+
+		explicit countdown(size_t n)    : remaining(n) {}
+
+		void arrive()    {if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) remaining.notify_all();}
+		void wait()      {for (size_t r; (r = remaining.load(std::memory_order_acquire)) != 0; ) remaining.wait(r);}
+	};
+
+	// A little arithmetic so that jobs are not entirely empty.
+	inline void spin(size_t n)
+	{
+		volatile size_t x = 0;
+		for (size_t i = 0; i < n; ++i) x = x + i;
+	}
+
+
+	template<class Pool>
+	void run_flat(Pool &pool, size_t jobs)
+	{
+		countdown done(jobs);
+		for (size_t i = 0; i < jobs; ++i) pool.post([&done]() {spin(50); done.arrive();});
+		done.wait();
+	}
+
+	template<class Pool>
+	void fork(Pool &pool, countdown &done, size_t depth)
+	{
+		spin(50);
+		if (depth) for (int i = 0; i < 2; ++i) pool.post([&pool, &done, depth]() {fork(pool, done, depth - 1);});
+		done.arrive();
+	}
+
+	template<class Pool>
+	void run_fork(Pool &pool, size_t depth)
+	{
+		countdown done((size_t(2) << depth) - 1);
+		pool.post([&]() {fork(pool, done, depth);});
+		done.wait();
+	}
+
+
+	void bench_executor()
+	{
+		const size_t threads = std::max(2u, std::thread::hardware_concurrency());
+		const size_t jobs = 1000000, depth = 19;
+		const size_t fork_jobs = (size_t(2) << depth) - 1;
+
+		std::cout << " " << threads << " threads" << std::endl;
+		{
+			mutex_pool pool(threads);
+			bench::time("mutex queue, flat", jobs,      [&] {run_flat(pool, jobs);});
+			bench::time("mutex queue, fork", fork_jobs, [&] {run_fork(pool, depth);});
+		}
+		for (auto order : {pleb::executor::order::lifo, pleb::executor::order::fifo})
+		{
+			const char *name = (order == pleb::executor::order::lifo) ? "lifo" : "fifo";
+
+			pleb::executor pool({threads, order});
+			bench::time(std::string("executor (") + name + "), flat", jobs,      [&] {run_flat(pool, jobs);});
+			bench::time(std::string("executor (") + name + "), fork", fork_jobs, [&] {run_fork(pool, depth);});
+		}
+
+		// Requests to a pooled service, answered through pleb::future.
+		{
+			const size_t requests = 200000;
+			pleb::topic topic("bench/executor/pooled");
+			auto svc = topic.serve([](pleb::request &r) {spin(50); r.respond_OK(1);}, pleb::flags::pooled);
+
+			std::vector<pleb::future<int>> futures;
+			futures.reserve(requests);
+			bench::time("pooled service requests", requests, [&]
+			{
+				for (size_t i = 0; i < requests; ++i) futures.push_back(topic.GET().send<int>());
+				for (auto &f : futures) f.get();
+				futures.clear();
+			});
+		}
+	}
+
+	bench::registration reg("executor", &bench_executor);
+}
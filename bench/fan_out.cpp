@@ -0,0 +1,45 @@
+#include <vector>
+#include <atomic>
+
+#include <pleb/pleb.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	Broadcasting to a topic with 20000 subscribers, each doing a little work.
+		Compares the serial walk with parallel fan-out on the default executor.
+*/
+
+
+namespace
+{
+	void bench_fan_out()
+	{
+		const size_t subscribers = 20000, events = 200;
+
+		// Hold the topic until the subscribers are gone.
+		pleb::topic topic("bench/fan_out");
+
+		std::atomic<size_t> received = 0;
+		std::vector<pleb::subscription_ptr> subs;
+		for (size_t i = 0; i < subscribers; ++i) subs.push_back(topic.subscribe([&](const pleb::event &e)
+		{
+			size_t x = *e.get<size_t>();
+			for (int k = 0; k < 16; ++k) x = x * 6364136223846793005u + 1442695040888963407u;
+			if (!x) ++received;
+		}));
+
+		for (size_t min : {size_t(0), size_t(1024)})
+		{
+			topic.fan_out(min);
+			bench::time(min ? "parallel fan-out" : "serial", events * subscribers, [&]
+			{
+				for (size_t i = 0; i < events; ++i) topic.publish(pleb::statuses::OK, i);
+			});
+		}
+		std::cout << "  (" << pleb::default_executor().thread_count() << " workers)" << std::endl;
+	}
+
+	bench::registration reg("fan_out", &bench_fan_out);
+}
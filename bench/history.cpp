@@ -0,0 +1,69 @@
+#include <deque>
+#include <mutex>
+
+#include <pleb/pleb.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	Flight recorders keeping the last 4096 events published under a topic.
+		Compares ad hoc recorders, each a subscriber copying every event into
+		a mutex-protected deque, with one event_history shared by all readers.
+		Reports the cost per publish.
+*/
+
+
+namespace
+{
+	struct flight_recorder
+	{
+		std::mutex              mutex;
+		std::deque<pleb::event> events;
+
+		void operator()(const pleb::event &e)
+		{
+			std::lock_guard lock(mutex);
+			events.push_back(e);
+			if (events.size() > 4096) events.pop_front();
+		}
+	};
+
+	void bench_history()
+	{
+		const size_t events = 1000000, recorders = 4;
+
+		pleb::topic topic("bench/history/sensor");
+
+		bench::time("no recording", events, [&]
+		{
+			for (size_t i = 0; i < events; ++i) topic.publish(pleb::statuses::OK, double(i));
+		});
+
+		{
+			std::vector<flight_recorder>        adhoc(recorders);
+			std::vector<pleb::subscription_ptr> subs;
+			for (auto &r : adhoc) subs.push_back(pleb::subscribe("bench/history", [&r](const pleb::event &e) {r(e);}));
+
+			bench::time("4 subscribers with deques", events, [&]
+			{
+				for (size_t i = 0; i < events; ++i) topic.publish(pleb::statuses::OK, double(i));
+			});
+		}
+
+		{
+			auto history = pleb::record("bench/history", 4096);
+
+			bench::time("event_history", events, [&]
+			{
+				for (size_t i = 0; i < events; ++i) topic.publish(pleb::statuses::OK, double(i));
+			});
+
+			double sum = 0;
+			auto n = history->replay(history->oldest(), [&](const pleb::event &e, const pleb::topic_path&) {sum += *e.get<double>();});
+			std::cout << "    " << n << " events in history" << std::endl;
+		}
+	}
+
+	bench::registration reg("history", &bench_history);
+}
@@ -0,0 +1,61 @@
+#include <algorithm>
+
+#include <pleb/pleb.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	A realtime publisher with a slow logging subscriber, which takes 20us per event.
+		Compares a synchronous subscription with queued subscriptions which
+		drop the oldest events or block when their mailbox is full.
+		Reports the publisher's latency per event and how many events were logged.
+*/
+
+
+namespace
+{
+	void busy_work(std::chrono::microseconds duration)
+	{
+		auto until = bench::clock::now() + duration;
+		while (bench::clock::now() < until) {}
+	}
+
+	void bench_mailbox()
+	{
+		const size_t events = 20000;
+
+		for (int mode = 0; mode < 3; ++mode)
+		{
+			std::atomic<size_t> logged = 0;
+			auto logger = [&](const pleb::event &e) {busy_work(std::chrono::microseconds(20)); ++logged;};
+
+			pleb::topic            topic("bench/mailbox/meter");
+			pleb::subscription_ptr sub;
+			if (mode == 0) sub = topic.subscribe(logger);
+			else           sub = topic.subscribe_queued(logger, {256, mode == 1 ? pleb::overflow_policy::drop_oldest : pleb::overflow_policy::block});
+
+			std::vector<double> latency;
+			latency.reserve(events);
+			auto begin = bench::clock::now();
+			for (size_t i = 0; i < events; ++i)
+			{
+				auto t = bench::clock::now();
+				topic.publish(pleb::statuses::OK, double(i));
+				latency.push_back(std::chrono::duration<double, std::micro>(bench::clock::now() - t).count());
+
+				// Publish at about 200kHz.
+				while (bench::clock::now() < begin + std::chrono::microseconds(5 * (i + 1))) {}
+			}
+			if (mode) while (static_cast<pleb::queued_subscription&>(*sub).pending()) std::this_thread::yield();
+
+			std::sort(latency.begin(), latency.end());
+			const char *label[] = {"synchronous", "queued, drop_oldest", "queued, block"};
+			std::cout << "  " << std::setw(20) << std::left << label[mode] << std::right << std::fixed << std::setprecision(2)
+				<< " publish p50 " << latency[events / 2] << "us, p99 " << latency[events * 99 / 100] << "us, max " << latency.back()
+				<< "us; " << logged << " of " << events << " logged" << std::endl;
+		}
+	}
+
+	bench::registration reg("mailbox", &bench_mailbox);
+}
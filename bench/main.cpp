@@ -0,0 +1,21 @@
+#include <cstring>
+
+#include "bench.hpp"
+
+
+/*
+	Run all benchmarks, or only those named on the command line.
+*/
+int main(int argc, char **argv)
+{
+	for (auto &entry : bench::registry())
+	{
+		bool selected = (argc < 2);
+		for (int i = 1; i < argc; ++i) if (!std::strcmp(argv[i], entry.name)) selected = true;
+		if (!selected) continue;
+
+		std::cout << entry.name << ":" << std::endl;
+		entry.run();
+		std::cout << std::endl;
+	}
+}
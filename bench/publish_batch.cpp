@@ -0,0 +1,53 @@
+#include <vector>
+
+#include <pleb/pleb.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	Sensor ingest publishing 10000 readings per tick to one topic_path.
+		A writer subscribes to the sensor, and a monitor to an ancestor.
+		Compares publishing each reading with publish_batch, with both a
+		per-event writer and a batch writer.
+*/
+
+
+namespace
+{
+	void bench_publish_batch()
+	{
+		const size_t ticks = 100, readings = 10000;
+
+		std::vector<double> tick(readings);
+		for (size_t i = 0; i < readings; ++i) tick[i] = double(i);
+
+		double monitored = 0, written = 0;
+		auto monitor = pleb::subscribe("bench/publish_batch", [&](const pleb::event &e) {monitored += *e.get<double>();});
+
+		pleb::topic_path sensor("bench/publish_batch/ingest/sensor/7");
+
+		for (int mode = 0; mode < 3; ++mode)
+		{
+			pleb::subscription_ptr writer;
+			if (mode < 2) writer = pleb::subscribe("bench/publish_batch/ingest", [&](const pleb::event &e) {written += *e.get<double>();});
+			else          writer = pleb::topic("bench/publish_batch/ingest").subscribe_batch([&](std::span<const pleb::event> events)
+			{
+				for (auto &e : events) written += *e.get<double>();
+			});
+
+			const char *label[] = {"publish each reading", "publish_batch, per-event writer", "publish_batch, batch writer"};
+			bench::time(label[mode], ticks * readings, [&]
+			{
+				for (size_t t = 0; t < ticks; ++t)
+				{
+					if (mode) sensor.publish_batch(pleb::statuses::OK, tick);
+					else for (double value : tick) sensor.publish(pleb::statuses::OK, value);
+				}
+			});
+		}
+		if (monitored != written) std::cout << "  (events were lost)" << std::endl;
+	}
+
+	bench::registration reg("publish_batch", &bench_publish_batch);
+}
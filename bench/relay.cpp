@@ -0,0 +1,49 @@
+#include <pleb/pleb.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	Requests through chains of relays, as with versioned APIs.
+		Compares a direct request with chains of 1 to 4 relays, built with
+		forward_requests and with services which re-issue each request as
+		forward_requests once did.
+*/
+
+
+namespace
+{
+	void bench_relay()
+	{
+		const size_t requests = 1000000;
+
+		auto svc = pleb::serve("bench/relay/api/v9/users", [](pleb::request &r) {r.respond_OK(1);});
+
+		bench::time("direct", requests, [&]
+		{
+			pleb::topic_path target("bench/relay/api/v9/users");
+			for (size_t i = 0; i < requests; ++i) (void) target.GET().await<int>();
+		});
+
+		for (bool structural : {false, true}) for (int hops : {1, 2, 4})
+		{
+			std::vector<pleb::service_ptr> relays;
+			for (int i = 0; i < hops; ++i)
+			{
+				pleb::topic from("bench/relay/api/v" + std::to_string(i + 10 * structural) + "/users");
+				pleb::topic to  ("bench/relay/api/v" + std::to_string(i + 1 == hops ? 9 : i + 1 + 10 * structural) + "/users");
+
+				if (structural) relays.push_back(from.forward_requests(to));
+				else relays.push_back(from.serve([to](pleb::request &r) {r.topic = to; to.issue(r);}));
+			}
+
+			bench::time((structural ? "forward_requests, " : "re-issuing relays, ") + std::to_string(hops) + " hops", requests, [&]
+			{
+				pleb::topic_path target("bench/relay/api/v" + std::to_string(10 * structural) + "/users");
+				for (size_t i = 0; i < requests; ++i) (void) target.GET().await<int>();
+			});
+		}
+	}
+
+	bench::registration reg("relay", &bench_relay);
+}
@@ -0,0 +1,62 @@
+#include <map>
+
+#include <pleb/pleb.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	Repeated GETs of configuration which rarely changes, with and without flags::caching.
+		The service looks up a setting and formats it, as a config service might.
+		One in every 10000 requests is a PUT, which invalidates the cache.
+*/
+
+
+namespace
+{
+	void bench_response_cache()
+	{
+		const size_t requests = 1000000, put_every = 10000;
+
+		std::map<std::string, std::string> settings;
+		for (int i = 0; i < 100; ++i) settings["setting" + std::to_string(i)] = std::to_string(i * 7919);
+
+		size_t calls = 0;
+		auto handler = [&](pleb::request &r)
+		{
+			if (r.method() == pleb::method::PUT) {settings["setting42"] = *r.get<std::string>(); return;}
+			++calls;
+			r.respond_OK("setting42=" + settings.at("setting42") + ";format=v1");
+		};
+
+		size_t length = 0;
+		for (pleb::service_config config : {pleb::service_config(), pleb::service_config(pleb::flags::caching)})
+		{
+			pleb::topic topic("bench/response_cache/config");
+			auto svc = topic.serve(handler, config);
+			calls = 0;
+
+			bench::time((config.handling & pleb::flags::caching) ? "GET, caching service" : "GET, ordinary service", requests, [&]
+			{
+				for (size_t i = 0; i < requests; ++i)
+				{
+					if (i % put_every == put_every - 1) topic.PUT(std::to_string(i));
+					else length += topic.GET().await<std::string>().size();
+				}
+			});
+			std::cout << "    service called " << calls << " times" << std::endl;
+
+			// Publishing beneath no caching service should not look for one, even while a cache lives.
+			pleb::topic elsewhere("bench/response_cache_unrelated/events");
+			auto sub = elsewhere.subscribe([](const pleb::event&) {});
+			bench::time("  publish elsewhere", requests, [&]
+			{
+				for (size_t i = 0; i < requests; ++i) elsewhere.publish(pleb::statuses::OK, i);
+			});
+		}
+
+		if (!length) std::cout << "  (no responses)" << std::endl;
+	}
+
+	bench::registration reg("response_cache", &bench_response_cache);
+}
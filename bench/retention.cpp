@@ -0,0 +1,78 @@
+#include <vector>
+#include <string>
+
+#include <pleb/pleb.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	A restart: 1000 subscribers each need the current state of their topic.
+		Without retention, each subscribes and then makes a GET to the
+		service which owns the state.  With retention, the last published
+		state arrives on subscribing.  Also reports the cost of publishing
+		into a retaining subtree, and of subscribing above a large subtree
+		while another retains.
+*/
+
+
+namespace
+{
+	void bench_retention()
+	{
+		const size_t topics = 1000, restarts = 100, publishes = 1000000;
+
+		std::vector<double> state(topics);
+		std::vector<pleb::topic> meters;
+		for (size_t i = 0; i < topics; ++i) meters.emplace_back("bench/retention/meter" + std::to_string(i));
+
+		size_t calls = 0;
+		auto svc = pleb::serve("bench/retention", [&](pleb::request &r)
+		{
+			++calls;
+			r.respond_OK(state[std::stoul(std::string(r.topic.id()).substr(5))]);
+		}, pleb::flags::default_receiver_ignore);
+
+		for (int mode = 0; mode < 2; ++mode)
+		{
+			std::shared_ptr<pleb::retention> retained;
+			if (mode) retained = pleb::retain("bench/retention", topics);
+
+			for (size_t i = 0; i < topics; ++i) meters[i].publish(pleb::statuses::OK, state[i] = double(i));
+
+			double sum = 0;
+			calls = 0;
+			bench::time(mode ? "subscribe, retained state" : "subscribe, then GET", restarts * topics, [&]
+			{
+				for (size_t n = 0; n < restarts; ++n)
+				{
+					std::vector<pleb::subscription_ptr> subs;
+					subs.reserve(topics);
+					for (auto &meter : meters)
+					{
+						subs.push_back(meter.subscribe([&](const pleb::event &e) {sum += *e.get<double>();}));
+						if (!mode) sum += meter.GET().await<double>();
+					}
+				}
+			});
+			std::cout << "    service called " << calls << " times" << std::endl;
+
+			bench::time(mode ? "publish, retaining" : "publish, not retaining", publishes, [&]
+			{
+				for (size_t i = 0; i < publishes; ++i) meters[i % topics].publish(pleb::statuses::OK, double(i));
+			});
+			if (sum != restarts * topics * (topics - 1) / 2) std::cout << "  (states were lost)" << std::endl;
+		}
+
+		// Subscribing above the meters need not search them while only another subtree retains.
+		auto elsewhere = pleb::retain("bench/retention_elsewhere", 1);
+		pleb::publish("bench/retention_elsewhere/meter", pleb::statuses::OK, 0.0);
+		auto watching = pleb::subscribe("bench/retention", [](const pleb::event&) {});
+		bench::time("subscribe above them, retained elsewhere", restarts, [&]
+		{
+			for (size_t n = 0; n < restarts; ++n) auto sub = pleb::subscribe("bench/retention", [](const pleb::event&) {});
+		});
+	}
+
+	bench::registration reg("retention", &bench_retention);
+}
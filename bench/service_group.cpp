@@ -0,0 +1,66 @@
+#include <mutex>
+
+#include <pleb/pleb.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	Throughput of a service group with 1 to 16 instances.
+		Each instance owns state guarded by a mutex, as a stateful
+		CPU-heavy service would, so one instance serializes all requests.
+		Sixteen threads issue requests concurrently.
+*/
+
+
+namespace
+{
+	struct stateful_instance
+	{
+		std::mutex mutex;
+		size_t     state = 0;
+
+		int handle()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (size_t i = 0; i < 2000; ++i) state = state * 6364136223846793005u + 1442695040888963407u;
+			return int(state & 0xFF);
+		}
+	};
+
+	void bench_service_group()
+	{
+		const size_t threads = 16, per_thread = 5000;
+		const pleb::balancing policies[] = {pleb::balancing::round_robin, pleb::balancing::least_outstanding, pleb::balancing::affinity};
+		const char *policy_names[]       = {"round robin", "least outstanding", "affinity"};
+
+		std::cout << " " << threads << " requesting threads, " << std::thread::hardware_concurrency() << " hardware threads" << std::endl;
+
+		for (size_t p = 0; p < 3; ++p)
+			for (size_t instances : {1, 2, 4, 8, 16})
+		{
+			pleb::topic topic("bench/service_group");
+
+			std::vector<std::unique_ptr<stateful_instance>> states;
+			std::vector<pleb::service_ptr>                  services;
+			for (size_t i = 0; i < instances; ++i)
+			{
+				states.emplace_back(new stateful_instance());
+				services.push_back(topic.serve_group([s = states.back().get()](pleb::request &r) {r.respond_OK(s->handle());}, {}, policies[p]));
+			}
+
+			std::string label = std::string(policy_names[p]) + ", " + std::to_string(instances) + " instances";
+			bench::time(label, threads * per_thread, [&]
+			{
+				std::vector<std::thread> requesters;
+				for (size_t t = 0; t < threads; ++t) requesters.emplace_back([&]
+				{
+					for (size_t i = 0; i < per_thread; ++i) (void) topic.GET().await<int>();
+				});
+				for (auto &t : requesters) t.join();
+			});
+		}
+	}
+
+	bench::registration reg("service_group", &bench_service_group);
+}
@@ -0,0 +1,94 @@
+#include <pleb/pleb.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	The timer wheel with 100k outstanding deadlines.
+		Scheduling and cancelling timers directly, deferred requests answered
+		within their deadlines, and deferred requests left to time out.
+*/
+
+
+namespace
+{
+	struct bench_timer : pleb::timer_wheel::timer
+	{
+		std::atomic<size_t>                  *fired;
+		pleb::timer_wheel::clock::time_point  due;
+		double                                late_us = 0;
+
+		~bench_timer()    {pleb::default_timer_wheel().cancel(*this);}
+
+		void expire() override
+		{
+			late_us = std::chrono::duration<double, std::micro>(pleb::timer_wheel::clock::now() - due).count();
+			fired->fetch_add(1, std::memory_order_release);
+		}
+	};
+
+	void bench_timer_wheel()
+	{
+		const size_t outstanding = 100000;
+		auto &wheel = pleb::default_timer_wheel();
+		auto  now   = pleb::timer_wheel::clock::now;
+
+		std::atomic<size_t>       fired = 0;
+		std::vector<bench_timer>  timers(outstanding);
+		for (auto &t : timers) t.fired = &fired;
+
+		// Spread over 1ms to 60s, so all levels of the wheel are used.
+		bench::time("schedule, 100k timers over 60s", outstanding, [&]
+		{
+			auto base = now();
+			for (size_t i = 0; i < outstanding; ++i) wheel.schedule(timers[i], base + std::chrono::microseconds(1000 + (i * 7919) % 60000000));
+		});
+		bench::time("cancel, 100k timers", outstanding, [&]
+		{
+			for (auto &t : timers) wheel.cancel(t);
+		});
+
+		// Deferred requests answered well within their deadlines.
+		pleb::topic topic("bench/timer_wheel/deferred");
+		std::vector<pleb::client_ptr> claimed;
+		claimed.reserve(outstanding);
+		auto svc = topic.serve([&](pleb::request &r) {claimed.push_back(r.claim_client());});
+
+		for (bool deadline : {false, true})
+		{
+			claimed.clear();
+			std::vector<pleb::future<pleb::response>> futures(outstanding);
+			bench::time(deadline ? "deferred requests, 30s deadline" : "deferred requests, no deadline", outstanding, [&]
+			{
+				for (size_t i = 0; i < outstanding; ++i)
+				{
+					pleb::request r(nullptr, topic, pleb::method::GET);
+					if (deadline) r.set_timeout(std::chrono::seconds(30));
+					r.issue(&futures[i]);
+				}
+				for (size_t i = 0; i < outstanding; ++i) claimed[i]->respond(topic, pleb::statuses::OK);
+				claimed.clear();
+			});
+			if (deadline) std::cout << "    timers pending afterward: " << wheel.pending() << std::endl;
+		}
+
+		// Timers left to expire within 100ms.
+		fired = 0;
+		auto base = now();
+		for (size_t i = 0; i < outstanding; ++i)
+		{
+			timers[i].due = base + std::chrono::microseconds((i * 7919) % 100000);
+			wheel.schedule(timers[i], timers[i].due);
+		}
+		while (fired.load(std::memory_order_acquire) < outstanding) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		auto elapsed = now() - base;
+
+		std::vector<double> late;
+		for (auto &t : timers) late.push_back(t.late_us);
+		std::sort(late.begin(), late.end());
+		std::cout << "  100k timers due within 100ms all fired after " << std::chrono::duration<double, std::milli>(elapsed).count() << "ms;"
+			<< " lateness p50 " << late[late.size() / 2] << "us, p99 " << late[late.size() * 99 / 100] << "us, max " << late.back() << "us" << std::endl;
+	}
+
+	bench::registration reg("timer_wheel", &bench_timer_wheel);
+}
@@ -0,0 +1,61 @@
+#include <vector>
+
+#include <pleb/pleb.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	Publishing to debug topics which nobody observes, and looking for
+		services where there are none, while other topics have receivers.
+*/
+
+
+namespace
+{
+	void bench_unobserved()
+	{
+		const size_t operations = 1000000;
+
+		// Unrelated subtrees with subscribers and services.
+		std::vector<pleb::subscription_ptr> subs;
+		std::vector<pleb::service_ptr>      services;
+		for (int i = 0; i < 100; ++i)
+		{
+			subs.push_back(pleb::subscribe("bench/unobserved/app/" + std::to_string(i), [](const pleb::event&) {}));
+			services.push_back(pleb::serve("bench/unobserved/app/" + std::to_string(i), [](pleb::request &r) {r.respond(pleb::statuses::OK);}));
+		}
+
+		pleb::topic_path debug("bench/unobserved/debug/module/trace");
+		pleb::topic      debug_node(debug);
+
+		bench::time("publish to an unobserved topic_path", operations, [&]
+		{
+			for (size_t i = 0; i < operations; ++i) debug.publish(pleb::statuses::OK, i);
+		});
+		bench::time("publish to an unobserved topic", operations, [&]
+		{
+			for (size_t i = 0; i < operations; ++i) debug_node.publish(pleb::statuses::OK, i);
+		});
+		// Retention and history elsewhere.
+		auto retained = pleb::retain("bench/unobserved/app", 1000);
+		auto recorded = pleb::record("bench/unobserved/app", 1024);
+		bench::time("  with retention and history elsewhere", operations, [&]
+		{
+			for (size_t i = 0; i < operations; ++i) debug_node.publish(pleb::statuses::OK, i);
+		});
+
+		size_t found = 0;
+		bench::time("find_service where none is", operations, [&]
+		{
+			for (size_t i = 0; i < operations; ++i) found += bool(debug_node.find_service());
+		});
+		bench::time("count_subscriptions where none is", operations, [&]
+		{
+			for (size_t i = 0; i < operations; ++i) found += debug_node.count_subscriptions();
+		});
+		if (found) std::cout << "  (found receivers)" << std::endl;
+	}
+
+	bench::registration reg("unobserved", &bench_unobserved);
+}
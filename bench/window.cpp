@@ -0,0 +1,49 @@
+#include <atomic>
+#include <thread>
+
+#include <pleb/pleb.hpp>
+
+#include "bench.hpp"
+
+
+/*
+	A writer taking 100000 events published to one topic, paying a fixed
+		cost of about 2us per call, as a database commit would.
+		Compares a per-event queued subscription with windowed batch
+		subscriptions of several sizes, each flushed on the executor.
+*/
+
+
+namespace
+{
+	void commit()
+	{
+		auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(2);
+		while (std::chrono::steady_clock::now() < until) {}
+	}
+
+	void bench_window()
+	{
+		const size_t events = 100000;
+		pleb::topic_path topic("bench/window/rows");
+
+		for (size_t size : {0, 16, 256})
+		{
+			std::atomic<size_t> written = 0;
+			std::shared_ptr<pleb::subscription> writer;
+			if (!size) writer = pleb::subscribe_queued(topic, [&](const pleb::event&) {commit(); ++written;},
+				pleb::mailbox_config{1024, pleb::overflow_policy::block});
+			else       writer = pleb::topic(topic).subscribe_batch([&](std::span<const pleb::event> rows) {commit(); written += rows.size();},
+				pleb::batch_window{size, std::chrono::milliseconds(1)});
+
+			std::string label = size ? "window of " + std::to_string(size) : "queued, one at a time";
+			bench::time(label, events, [&]
+			{
+				for (size_t i = 0; i < events; ++i) topic.publish(pleb::statuses::OK, double(i));
+				while (written < events) std::this_thread::yield();
+			});
+		}
+	}
+
+	bench::registration reg("window", &bench_window);
+}
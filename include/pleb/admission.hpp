@@ -0,0 +1,145 @@
+#pragma once
+
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <memory>
+
+#include "executor.hpp"
+
+/*
+	Admission control for services; see service::set_limits.
+
+	A limited service handles at most a set number of requests at once.
+		Requests beyond that wait their turn, up to a queue limit, and run on
+		the default executor as earlier requests finish.  Requests beyond
+		both limits are rejected before the service sees them: they go to an
+		overflow handler if there is one, or are answered ServiceUnavailable.
+
+	The counters are lock-free; only waiting requests are held under a mutex.
+*/
+
+
+namespace pleb
+{
+	struct admission_limits
+	{
+		static constexpr size_t unlimited = ~size_t(0);
+
+		size_t concurrency = unlimited; // Requests handled at once.
+		size_t queue       = unlimited; // Requests waiting for a turn.
+	};
+
+	/*
+		A snapshot of a service's load, for throttling upstream.
+	*/
+	struct service_load
+	{
+		size_t           running;  // Requests being handled.
+		size_t           queued;   // Requests waiting for a turn.
+		size_t           rejected; // Requests turned away since limits were first set.
+		admission_limits limits;
+
+		// Whether a new request would be rejected.
+		bool saturated() const noexcept    {return running >= limits.concurrency && queued >= limits.queue;}
+	};
+
+
+	namespace detail
+	{
+		class admission
+		{
+		public:
+			std::atomic<size_t> concurrency, queue;
+			std::atomic<size_t> running = 0, queued = 0, rejected = 0;
+
+			std::atomic<std::shared_ptr<const service_function>> overflow;
+
+
+		public:
+			admission(admission_limits limits)
+				:
+				concurrency(limits.concurrency), queue(limits.queue) {}
+
+			// Take a turn to handle a request now, if the concurrency limit allows.
+			bool try_begin() noexcept    {return _try_increment(running, concurrency);}
+
+			// End a turn, and start a waiting request if there is one.
+			void end()
+			{
+				running.fetch_sub(1);
+				resume();
+			}
+
+			// Ends a turn upon destruction.
+			class turn
+			{
+			public:
+				explicit turn(admission &a) noexcept    : _a(&a) {}
+				turn(turn &&o) noexcept                 : _a(o._a) {o._a = nullptr;}
+				~turn()                                 {if (_a) _a->end();}
+
+			private:
+				admission *_a;
+			};
+
+			// Take a place in the queue, if the queue limit allows.
+			bool try_enqueue() noexcept    {return _try_increment(queued, queue);}
+
+			/*
+				Hold a job until a turn is available, then post it to the default executor.
+					Its place in the queue must be taken first.  The job must end its turn.
+			*/
+			template<typename Function>
+			void park(Function &&function)
+			{
+				std::unique_ptr<executor_job> job(new executor_job_of<std::decay_t<Function>>(std::forward<Function>(function)));
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					_parked.push_back(std::move(job));
+					_waiting.fetch_add(1);
+				}
+				resume();
+			}
+
+			// Start waiting jobs while turns are available.
+			void resume()
+			{
+				// Sequentially consistent with end(), so a job parked as a turn ends is never stranded.
+				while (_waiting.load() && try_begin())
+				{
+					auto job = _unpark();
+					if (!job) {running.fetch_sub(1); continue;}
+					default_executor().post([job = std::move(job)] {job->run();});
+				}
+			}
+
+
+		private:
+			std::mutex                                _mutex;
+			std::deque<std::unique_ptr<executor_job>> _parked;
+			std::atomic<size_t>                       _waiting = 0;
+
+			// Remove the oldest waiting job, if any, releasing its place in the queue.
+			std::unique_ptr<executor_job> _unpark()
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				if (_parked.empty()) return nullptr;
+				auto job = std::move(_parked.front());
+				_parked.pop_front();
+				_waiting.fetch_sub(1);
+				queued.fetch_sub(1, std::memory_order_release);
+				return job;
+			}
+
+			static bool _try_increment(std::atomic<size_t> &count, const std::atomic<size_t> &limit) noexcept
+			{
+				size_t n = count.load(std::memory_order_relaxed);
+				do {if (n >= limit.load(std::memory_order_relaxed)) return false;}
+				while (!count.compare_exchange_weak(n, n + 1));
+				return true;
+			}
+		};
+	}
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+
+#include <vector>
+#include <memory>
+
+#include "event.hpp"
+#include "request.hpp"
+
+/*
+	Receiver announcements; see discover.hpp.
+
+	Each new service or subscription is announced by publishing an event
+		flagged announce_receiver to its topic, recursively, which discovery
+		subscribers receive.  Announcements are skipped while no subscription
+		accepts them, so registering receivers is cheap when nothing is
+		discovering them.
+
+	Registering many receivers at once, as at startup, may be done within an
+		announcement_batch.  Its announcements are collected and published
+		when it closes, as one summary event per topic whose value is a
+		std::vector of subscription_ptr or service_ptr, or else discarded.
+*/
+
+
+namespace pleb
+{
+	/*
+		Collects the announcements made on this thread while it exists.
+			Batches may be nested; the outermost one publishes.
+	*/
+	class announcement_batch
+	{
+	public:
+		enum mode : uint8_t
+		{
+			summarize, // Publish one announcement per topic when the batch closes.
+			suppress,  // Discard the announcements.
+		};
+
+
+	public:
+		explicit announcement_batch(mode m = summarize) noexcept
+			:
+			_mode(m), _outer(_current)    {_current = this;}
+
+		~announcement_batch();
+
+		announcement_batch(const announcement_batch&) = delete;
+		void operator=(const announcement_batch&) = delete;
+
+		// Publish the announcements collected so far, unless suppressed.
+		void flush();
+
+		// Number of announcements waiting to be published.
+		size_t size() const noexcept    {return _subscriptions.size() + _services.size();}
+
+
+	private:
+		template<class P> friend class topic_;
+
+		const mode                    _mode;
+		announcement_batch *const     _outer;
+		std::vector<subscription_ptr> _subscriptions;
+		std::vector<service_ptr>      _services;
+
+		static inline thread_local announcement_batch *_current = nullptr;
+
+		// The batch collecting this thread's announcements, if any.
+		static announcement_batch *_collecting() noexcept
+		{
+			auto *batch = _current;
+			while (batch && batch->_outer && batch->_mode == summarize) batch = batch->_outer;
+			return batch;
+		}
+
+		void _collect(const subscription_ptr &s)    {if (_mode == summarize) _subscriptions.push_back(s);}
+		void _collect(const service_ptr      &s)    {if (_mode == summarize) _services.push_back(s);}
+	};
+}
@@ -0,0 +1,222 @@
+#pragma once
+
+
+#include <bit>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <cstdint>
+
+#include "event.hpp"
+
+/*
+	Latest-value subscriptions; see topic::subscribe_latest.
+
+	For state-like topics, a slow consumer needs only the newest event.
+		A latest_subscription keeps one event, replacing it on each publish,
+		and the consumer takes it at its own rate by calling drain().
+
+	The event is held in a set of reusable buffers.  Each publisher copies its
+		event into a spare buffer of its own, then swaps that buffer in as the
+		waiting one, so the newest event always replaces the last and none is
+		lost to an overlapping publish.  Once the buffers have been filled,
+		publishing doesn't allocate for values which fit in std::any's internal
+		storage.  Publishers only wait if more than fourteen of them are
+		storing to one subscription at once.
+
+	Many subscriptions may share a conflation_group, which lists those with a
+		new event so that a consumer of thousands of topics visits only those
+		which have changed.  Drain such subscriptions through the group.
+*/
+
+
+namespace pleb
+{
+	class latest_subscription;
+
+
+	/*
+		A set of latest-value subscriptions with one consumer.
+	*/
+	class conflation_group
+	{
+	public:
+		conflation_group() = default;
+		~conflation_group();
+
+		conflation_group(const conflation_group&) = delete;
+		void operator=(const conflation_group&) = delete;
+
+		// Deliver the newest event of each subscription updated since the last drain.
+		size_t drain();
+
+		// Whether any subscription has a new event.
+		bool pending() const noexcept    {return _head.load(std::memory_order_relaxed) != nullptr;}
+
+
+	private:
+		friend class latest_subscription;
+
+		// Updated subscriptions, newest first.
+		std::atomic<latest_subscription*> _head = nullptr;
+
+		void _push(latest_subscription *s) noexcept;
+	};
+
+
+	/*
+		A subscription which keeps only the newest event.
+	*/
+	class latest_subscription : public subscription
+	{
+	public:
+		// Note this class will normally only be created by topic::subscribe_latest().
+		latest_subscription(
+			const pleb::topic                 &_topic,
+			subscriber_function              &&_func,
+			std::shared_ptr<conflation_group>  group,
+			subscription_config                flags = {})
+			:
+			subscription(_topic, [this](const pleb::event &e) {store(e);}, flags, delivery_mode::latest),
+			_consumer(std::move(_func)), _group(group) {}
+
+		// Replace the waiting event, if any.  Borrowed content is copied.
+		void store(const pleb::event &e)
+		{
+			uint8_t slot = _claim();
+			try
+			{
+				auto &buffer = _slots[slot];
+				if (buffer) *buffer = e;
+				else        buffer = std::make_unique<pleb::event>(e);
+				detail::own_content(*buffer);
+			}
+			catch (...)
+			{
+				_free.fetch_or(uint32_t(1) << slot, std::memory_order_release);
+				throw;
+			}
+
+			// The last publisher to swap its buffer in wins; the buffer it replaces becomes spare.
+			uint8_t prior = _middle.exchange(slot | _fresh, std::memory_order_acq_rel);
+			_free.fetch_or(uint32_t(1) << (prior & _index), std::memory_order_release);
+
+			if (prior & _fresh) _conflated.fetch_add(1, std::memory_order_relaxed);
+			else                _list();
+		}
+
+		/*
+			Deliver the waiting event on this thread, if there is one.
+				Only one thread may drain a subscription.
+		*/
+		bool drain();
+
+		// Whether an event is waiting.
+		bool pending() const noexcept    {return _middle.load(std::memory_order_relaxed) & _fresh;}
+
+		// Number of events replaced before they were delivered.
+		size_t conflated() const noexcept    {return _conflated.load(std::memory_order_relaxed);}
+
+
+	private:
+		template<class P> friend class topic_;
+		friend class conflation_group;
+
+		static constexpr uint8_t _slot_count = 16, _index = 15, _fresh = 16;
+
+		const subscriber_function       _consumer;
+		std::unique_ptr<pleb::event>    _slots[_slot_count];
+		std::atomic<uint8_t>            _middle = 0;      // Buffer between the publishers and the consumer.
+		uint8_t                         _front  = 1;      // Read by the consumer.
+		std::atomic<uint32_t>           _free   = ((uint32_t(1) << _slot_count) - 1) & ~uint32_t(3);    // Spare buffers.
+		std::atomic<size_t>             _conflated = 0;
+
+		const std::weak_ptr<conflation_group> _group;
+		std::weak_ptr<latest_subscription>    _self;
+
+		// While listed in the group, the subscription is kept alive.
+		latest_subscription                 *_next = nullptr;
+		std::shared_ptr<latest_subscription> _listed;
+
+		// Take a spare buffer for a publisher.
+		uint8_t _claim() noexcept
+		{
+			uint32_t free = _free.load(std::memory_order_relaxed);
+			while (true)
+			{
+				if (!free) {std::this_thread::yield(); free = _free.load(std::memory_order_relaxed); continue;}
+				uint32_t slot = uint32_t(std::countr_zero(free));
+				if (_free.compare_exchange_weak(free, free & ~(uint32_t(1) << slot), std::memory_order_acquire, std::memory_order_relaxed))
+					return uint8_t(slot);
+			}
+		}
+
+		// List this subscription in its group, now that it has a new event.
+		void _list()
+		{
+			if (auto group = _group.lock()) if ((_listed = _self.lock())) group->_push(this);
+		}
+	};
+
+
+	inline conflation_group::~conflation_group()
+	{
+		for (auto *s = _head.exchange(nullptr, std::memory_order_acquire); s; )
+		{
+			auto *next = s->_next;
+			s->_listed.reset();
+			s = next;
+		}
+	}
+
+	inline void conflation_group::_push(latest_subscription *s) noexcept
+	{
+		s->_next = _head.load(std::memory_order_relaxed);
+		while (!_head.compare_exchange_weak(s->_next, s, std::memory_order_release, std::memory_order_relaxed)) {}
+	}
+
+	inline size_t conflation_group::drain()
+	{
+		// Take the whole list, and visit it oldest first.
+		latest_subscription *list = nullptr;
+		for (auto *s = _head.exchange(nullptr, std::memory_order_acquire); s; )
+		{
+			auto *next = s->_next;
+			s->_next = list;
+			list = s;
+			s = next;
+		}
+
+		size_t n = 0;
+		while (list)
+		{
+			// Unlist before taking the event, so the next publish lists the subscription again.
+			auto keep = std::move(list->_listed);
+			auto *s   = list;
+			list = list->_next;
+			if (s->drain()) ++n;
+		}
+		return n;
+	}
+
+
+	/*
+		Implementation of methods from the topic class.
+	*/
+	template<typename P> [[nodiscard]]
+	std::shared_ptr<latest_subscription> topic_<P>::subscribe_latest(
+		subscriber_function               &&f,
+		std::shared_ptr<conflation_group>   group,
+		subscription_config                 flags)
+	{
+		auto &node = this->_realize();
+		if constexpr (type_can_be_null) null_topic_error::check(node, "can't subscribe", "(null topic)");
+
+		auto sub = std::make_shared<latest_subscription>(topic(node), std::move(f), std::move(group), flags);
+		sub->_self = sub;
+		node->insert_subscriber(sub);
+		_announce(sub);
+		_replay_retained(node, sub);
+		return sub;
+	}
+}
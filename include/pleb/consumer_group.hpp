@@ -0,0 +1,224 @@
+#pragma once
+
+
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <functional>
+
+#include "event.hpp"
+#include "executor.hpp"
+
+/*
+	Shared subscriptions; see topic::subscribe_shared.
+
+	Members of a consumer group compete for its events: each event reaching
+		the group is delivered to one live member, chosen by a balancing
+		policy, rather than to all of them.  This spreads the processing of
+		a topic's events among workers.
+
+	The group is one subscription at its topic.  Members hold the group, and
+		the group holds its members weakly, so it lasts as long as any member.
+		Choosing a member is lock-free; a member which expires while it is
+		being chosen is simply passed over.  Only joining a group, and a
+		group expiring, take a lock, to find the group by name.
+*/
+
+
+namespace pleb
+{
+	class consumer_group;
+
+
+	/*
+		A member of a consumer group.
+	*/
+	class shared_subscription : public subscription
+	{
+	public:
+		const std::shared_ptr<consumer_group> group;
+
+
+	public:
+		// Note this class will normally only be created by topic::subscribe_shared().
+		shared_subscription(
+			const pleb::topic               &_topic,
+			subscriber_function            &&_func,
+			std::shared_ptr<consumer_group>  _group,
+			subscription_config              flags = {})
+			:
+			subscription(_topic, std::move(_func), flags), group(std::move(_group)) {}
+
+		// Number of events this member is handling or has waiting on the executor.
+		size_t outstanding() const noexcept    {return _outstanding.load(std::memory_order_relaxed);}
+
+		// Number of events delivered to this member.
+		size_t delivered() const noexcept      {return _delivered.load(std::memory_order_relaxed);}
+
+
+	private:
+		friend class consumer_group;
+		std::atomic<size_t> _outstanding = 0, _delivered = 0;
+	};
+
+
+	/*
+		A named group of shared subscriptions at one topic.
+			Events are received on the group's behalf and passed to one member.
+			The group filters events as its first member does; each member's
+			own handling flags, such as flags::pooled, apply to its events.
+	*/
+	class consumer_group : public subscription
+	{
+	public:
+		const std::string name;
+
+
+	public:
+		// Note this class will normally only be created by topic::subscribe_shared().
+		consumer_group(
+			const pleb::topic   &_topic,
+			std::string_view     _name,
+			balancing            policy,
+			subscription_config  flags = {})
+			:
+			subscription(_topic, [this](const pleb::event &e) {dispatch(e);}, subscription_config(flags.filtering)),
+			name(_name), _balancing(policy) {}
+
+		~consumer_group()
+		{
+			if (!_registered) return;
+			std::lock_guard<std::mutex> lock(_mutex());
+			auto i = _registry().find({_registered, name});
+			if (i != _registry().end() && i->second.expired()) _registry().erase(i);
+		}
+
+		// Choose the balancing policy for the group.
+		void set_balancing(balancing policy) noexcept    {_balancing.store(policy, std::memory_order_relaxed);}
+
+		// Deliver an event to one live member.  Returns false if there was none.
+		bool dispatch(const pleb::event &e)
+		{
+			auto member = _choose();
+			if (!member) return false;
+
+			member->_delivered.fetch_add(1, std::memory_order_relaxed);
+			member->_outstanding.fetch_add(1, std::memory_order_relaxed);
+
+			if (!(e.requirements & flags::immediate) && (member->handling & flags::pooled))
+			{
+				default_executor().post([member, ev = detail::share_event(e)]()
+				{
+					_call(*member, *ev);
+				});
+			}
+			else _call(*member, e);
+			return true;
+		}
+
+		// Number of live members.
+		size_t size() const    {size_t n = 0; for (auto i = _members.begin(), e = _members.end(); i != e; ++i) ++n; return n;}
+
+
+	private:
+		template<class P> friend class topic_;
+		coop::unmanaged::pool<shared_subscription> _members;
+		std::atomic<balancing>                     _balancing;
+		mutable std::atomic<size_t>                _cursor = 0;
+		const void                                *_registered = nullptr; // Registry key, until expiry.
+
+		// Groups by topic and name, used only when joining.
+		using registry_t = std::map<std::pair<const void*, std::string>, std::weak_ptr<consumer_group>>;
+		static registry_t &_registry()    {static registry_t r; return r;}
+		static std::mutex &_mutex()       {static std::mutex m; return m;}
+
+		// Call a member, which has been counted as outstanding.
+		static void _call(shared_subscription &member, const pleb::event &e);
+
+		// Choose a member by the balancing policy.
+		std::shared_ptr<shared_subscription> _choose() const
+		{
+			switch (_balancing.load(std::memory_order_relaxed))
+			{
+			case balancing::least_outstanding:
+				{
+					// Find the least load, then take the next member at that load, so ties rotate.
+					size_t least = ~size_t(0);
+					_members.visit_range(0, _members.capacity(), [&least](const std::shared_ptr<shared_subscription> &m)
+					{
+						least = std::min(least, m->outstanding());
+					});
+					return _rotate([least](const shared_subscription &m) {return m.outstanding() <= least;});
+				}
+			case balancing::affinity:
+				return _members.lock_from(std::hash<std::thread::id>()(std::this_thread::get_id()), [](const shared_subscription&) {return true;});
+
+			case balancing::round_robin:
+			default:
+				return _rotate([](const shared_subscription&) {return true;});
+			}
+		}
+
+		/*
+			Take the next accepted member after the cursor, moving the cursor past it.
+				A publisher which loses the race to move the cursor chooses again,
+				so concurrent events go to successive members.
+		*/
+		template<typename Predicate>
+		std::shared_ptr<shared_subscription> _rotate(const Predicate &accept) const
+		{
+			size_t position = _cursor.load(std::memory_order_relaxed), found = 0;
+			while (true)
+			{
+				auto member = _members.lock_from(position, accept, &found);
+				if (!member) return nullptr;
+				if (_cursor.compare_exchange_weak(position, found + 1, std::memory_order_relaxed)) return member;
+			}
+		}
+	};
+
+
+	/*
+		Implementation of methods from the topic class.
+	*/
+	template<typename P> [[nodiscard]]
+	std::shared_ptr<shared_subscription> topic_<P>::subscribe_shared(
+		std::string_view      group_name,
+		subscriber_function &&f,
+		balancing             policy,
+		subscription_config   flags)
+	{
+		auto &node = this->_realize();
+		if constexpr (type_can_be_null) null_topic_error::check(node, "can't subscribe", "(null topic)");
+
+		// A new group is joined and placed at the node before another member can find it.
+		//   The group outlives the lock, since it may expire only outside it.
+		std::shared_ptr<consumer_group>      group;
+		std::shared_ptr<shared_subscription> sub;
+		bool                                 created = false;
+		{
+			std::lock_guard<std::mutex> lock(consumer_group::_mutex());
+			auto &entry = consumer_group::_registry()[{node.get(), std::string(group_name)}];
+			if (!(group = entry.lock()))
+			{
+				group   = std::make_shared<consumer_group>(topic(node), group_name, policy, flags);
+				group->_registered = node.get();
+				entry   = group;
+				created = true;
+			}
+			else group->set_balancing(policy);
+
+			sub = std::make_shared<shared_subscription>(topic(node), std::move(f), group, flags);
+			group->_members.insert(sub);
+			if (created) node->insert_subscriber(group);
+		}
+
+		if (created) _replay_retained(node, group);
+		_announce(sub);
+		return sub;
+	}
+}
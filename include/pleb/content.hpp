@@ -16,15 +16,29 @@ namespace pleb
 	namespace std_any = ::std;
 #endif
 
+	namespace detail
+	{
+		/*
+			A borrowed view of another message's value, used to pass content on without copying.
+				It is valid only while that message is being delivered.
+		*/
+		struct any_view
+		{
+			const std_any::any *value;
+		};
+	}
+
 	/*
 		Functions which attempt to derive a pointer to T from std::any.
 			(note std_any namespace alias for substitute implementations of std::any)
 			These allow T to be supplied by value or a shared_ptr.
+			Const pointers may also be derived through a detail::any_view.
 	*/
 	template<typename T>
 	T *any_ptr(const std_any::any &value)
 	{
 		if (auto t = std_any::any_cast<std::shared_ptr<T>>(&value)) return &**t;
+		if (auto v = std_any::any_cast<detail::any_view>  (&value)) return any_ptr<T>(*v->value);
 		//if (auto t = std_any::any_cast<T*>                (&value)) return *t;
 		return nullptr;
 	}
@@ -39,6 +53,7 @@ namespace pleb
 	{
 		if (auto t = std_any::any_cast<T>                       (&value)) return t;
 		if (auto t = std_any::any_cast<std::shared_ptr<const T>>(&value)) return &**t;
+		if (auto v = std_any::any_cast<detail::any_view>        (&value)) return any_const_ptr<T>(*v->value);
 		//if (auto t = std_any::any_cast<const T*>                (&value)) return &**t;
 		return any_ptr<T>(value);
 	}
@@ -89,7 +104,13 @@ namespace pleb
 
 
 		// Access value as a specific type.  Only succeeds if the type is an exact match.
-		template<class T> const T *value_cast()  const noexcept    {return std_any::any_cast<T>(&_value);}
+		//  The const form also sees through views of another message's value.
+		template<class T> const T *value_cast()  const noexcept
+		{
+			if (auto *t = std_any::any_cast<T>(&_value)) return t;
+			if (auto *v = std_any::any_cast<detail::any_view>(&_value)) return std_any::any_cast<T>(v->value);
+			return nullptr;
+		}
 		template<class T> T       *value_cast()        noexcept    {return std_any::any_cast<T>(&_value);}
 
 		// Get a constant pointer to the value.
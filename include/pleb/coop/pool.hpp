@@ -6,6 +6,7 @@
 #include <memory>     // std::shared_ptr and weak_ptr
 #include <atomic>
 #include <stdexcept>  // std::logic_error
+#include <algorithm>  // std::min and max
 
 
 /*
@@ -350,6 +351,8 @@ namespace coop
 				const slot *slot_begin() const noexcept    {return _buffer.slot_begin();}
 				const slot *slot_end  () const noexcept    {return _buffer.slot_end();}
 
+				const buffer_chain *next() const noexcept    {return _next.load(std::memory_order_acquire);}
+
 			private:
 				static buffer_chain *_alloc(size_t capacity)
 				{
@@ -433,6 +436,78 @@ namespace coop
 				return nullptr;
 			}
 
+			/*
+				Reference an external value, such as an instance of a child class.
+					The pool holds it like a weak_ptr.  Always succeeds unless an exception is thrown.
+			*/
+			void insert(const std::shared_ptr<value_type> &elem)
+			{
+				for (buffer_chain *buf = &this->_first; buf; buf = buf->more())
+					for (auto i = buf->slot_begin(), e = buf->slot_end(); i != e; ++i)
+						if (i->try_insert(elem))
+							return;
+			}
+
+			/*
+				Lock the first element accepted by a predicate, searching from
+					some slot position and wrapping around.  The position of the
+					element is optionally stored.  Used to spread load across elements.
+			*/
+			template<typename Predicate>
+			std::shared_ptr<value_type> lock_from(size_t position, Predicate &&accept, size_t *found = nullptr) const
+			{
+				size_t total = 0;
+				for (const buffer_chain *buf = &this->_first; buf; buf = buf->next()) total += buf->slot_end() - buf->slot_begin();
+				position %= total;
+
+				// First search from the position to the end, then from the beginning.
+				for (int pass = 0; pass < 2; ++pass)
+				{
+					size_t index = 0;
+					for (const buffer_chain *buf = &this->_first; buf; buf = buf->next())
+						for (auto i = buf->slot_begin(), e = buf->slot_end(); i != e; ++i, ++index)
+					{
+						if ((index >= position) != (pass == 0)) continue;
+						if (auto ptr = i->lock()) if (accept(*ptr))
+						{
+							if (found) *found = index;
+							return ptr;
+						}
+					}
+				}
+				return nullptr;
+			}
+
+			/*
+				Count the slots in the pool, occupied or not.
+					This is the most elements the pool has held at once, rounded up.
+			*/
+			size_t capacity() const noexcept
+			{
+				size_t total = 0;
+				for (const buffer_chain *buf = &this->_first; buf; buf = buf->next()) total += buf->slot_end() - buf->slot_begin();
+				return total;
+			}
+
+			/*
+				Call a function with each element in a range of slot positions.
+					Used to divide iteration among threads.  Elements are retained
+					by a shared_ptr while the function is called.
+			*/
+			template<typename Function>
+			void visit_range(size_t first, size_t last, Function &&function) const
+			{
+				size_t index = 0;
+				for (const buffer_chain *buf = &this->_first; buf && index < last; buf = buf->next())
+				{
+					size_t size = buf->slot_end() - buf->slot_begin();
+					if (index + size > first)
+						for (auto i = buf->slot_begin() + (std::max(first, index) - index), e = buf->slot_begin() + (std::min(last, index + size) - index); i != e; ++i)
+							if (auto ptr = i->lock()) function(ptr);
+					index += size;
+				}
+			}
+
 		protected:
 			pool(const pool&) = delete;
 			pool(pool&&) = delete;
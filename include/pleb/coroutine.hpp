@@ -0,0 +1,447 @@
+#pragma once
+
+
+#include <coroutine>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <atomic>
+#include <optional>
+#include <exception>
+#include <stdexcept>
+
+#include "request.hpp"
+
+/*
+	C++20 coroutine support for PLEB requests.
+
+	Requests may be awaited from a coroutine:
+		pleb::response r = co_await pleb::GET("svc/x");
+		std::string    s = co_await pleb::awaitable<std::string>(topic.POST(v));
+
+	If the service responds before returning, the coroutine continues
+		without suspending.  Otherwise it is resumed on the responding thread,
+		as soon as the service has responded and released its client.
+		No thread blocks and no memory is allocated in either case;
+		the client lives in the coroutine frame alongside the request.
+
+	pleb::task<T> is a minimal lazily-started coroutine type for
+		writing code that awaits requests.
+
+	Services may also be coroutines:
+		auto svc = topic.serve([](pleb::request &r) -> pleb::task<void>
+		{
+			r.respond_OK(co_await pleb::awaitable<int>(pleb::GET("svc/x")));
+		});
+*/
+
+
+namespace pleb
+{
+	namespace detail
+	{
+		/*
+			A client living in a coroutine frame, used by request_awaiter.
+				Its shared_ptr control block is stored in place.  When the last
+				reference is released, a suspended coroutine is resumed.
+		*/
+		template<typename T>
+		class coroutine_client : public client, public response_slot<T>
+		{
+		public:
+			coroutine_client()
+				:
+				client([this](response &r) {this->_receive(r);}, flags::realtime) {}
+
+			// Produce the one reference to this client.
+			client_ptr share()
+			{
+				return client_ptr(static_cast<client*>(this), [](client*) noexcept {},
+					control_block_allocator<char, coroutine_client>(this));
+			}
+
+			// Check whether every reference to the client has been released.
+			bool is_released() const noexcept    {return _state.load(std::memory_order_acquire) & released;}
+
+			// Arrange to resume the coroutine upon release.  Returns false if already released.
+			bool suspend(std::coroutine_handle<> handle) noexcept
+			{
+				_handle = handle;
+				return !(_state.fetch_or(suspended, std::memory_order_acq_rel) & released);
+			}
+
+
+		private:
+			template<typename, class> friend struct control_block_allocator;
+
+			enum : uint8_t {released = 1, suspended = 2};
+
+			std::atomic<uint8_t>    _state = 0;
+			std::coroutine_handle<> _handle;
+
+			alignas(std::max_align_t) unsigned char _cb_buffer[8*sizeof(void*)];
+
+			void _cb_released() noexcept
+			{
+				if (_state.fetch_or(released, std::memory_order_acq_rel) & suspended) _handle.resume();
+			}
+		};
+	}
+
+
+	namespace detail
+	{
+		/*
+			Cancellation state of a task, shared with the request it awaits.
+				Cancelling the task cancels that request's client, and any
+				request it awaits afterward.
+		*/
+		class task_cancellation
+		{
+		public:
+			void cancel() noexcept
+			{
+				client *awaiting;
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					_cancelled = true;
+					awaiting   = _awaiting;
+					if (awaiting) _cancelling = std::this_thread::get_id();
+				}
+				if (!awaiting) return;
+
+				// Cancel outside the lock; the callbacks may resume the coroutine on this thread.
+				awaiting->cancel();
+				std::lock_guard<std::mutex> lock(_mutex);
+				_cancelling = {};
+				_cancelled_idle.notify_all();
+			}
+
+			bool is_cancelled() const noexcept    {std::lock_guard<std::mutex> lock(_mutex); return _cancelled;}
+
+			/*
+				Set or clear the client of the request being awaited.
+					A client being cancelled by another thread is kept until that finishes.
+			*/
+			void await(client *awaiting) noexcept
+			{
+				{
+					std::unique_lock<std::mutex> lock(_mutex);
+					_cancelled_idle.wait(lock, [this]
+					{
+						return _cancelling == std::thread::id() || _cancelling == std::this_thread::get_id();
+					});
+					_awaiting = awaiting;
+					if (!_cancelled) return;
+				}
+				if (awaiting) awaiting->cancel();
+			}
+
+
+		private:
+			mutable std::mutex      _mutex;
+			std::condition_variable _cancelled_idle;
+			client                 *_awaiting   = nullptr;
+			std::thread::id         _cancelling;
+			bool                    _cancelled  = false;
+		};
+	}
+
+
+	/*
+		Awaiter which issues a request from a coroutine.
+			The request must remain valid until the coroutine is resumed;
+			this is naturally the case for a temporary in a co_await expression.
+
+		Unless T is pleb::response, status is discarded and a response
+			of incompatible type will throw bad_any_cast.
+	*/
+	template<typename T = response>
+	class request_awaiter
+	{
+	public:
+		explicit request_awaiter(request &r) noexcept    : _request(r) {}
+
+		// Issue the request.  No suspension occurs if the response is immediate.
+		bool await_ready()
+		{
+			_request.issue_and_release(_client.share());
+			return _client.is_released();
+		}
+
+		// If the awaiting coroutine is a task, cancelling it cancels this request.
+		template<typename Promise>
+		bool await_suspend(std::coroutine_handle<Promise> handle) noexcept
+		{
+			if constexpr (std::is_base_of_v<detail::task_cancellation, Promise>)
+			{
+				_cancellation = &handle.promise();
+				_cancellation->await(&_client);
+			}
+			return _client.suspend(handle);
+		}
+
+		T await_resume()
+		{
+			if (_cancellation) _cancellation->await(nullptr);
+			return _client.take();
+		}
+
+
+	private:
+		request                         &_request;
+		detail::coroutine_client<T>      _client;
+		detail::task_cancellation       *_cancellation = nullptr;
+	};
+
+
+	/*
+		Await a request, receiving the response as some type T.
+	*/
+	template<typename T = response>
+	request_awaiter<T> awaitable(request &r) noexcept     {return request_awaiter<T>(r);}
+	template<typename T = response>
+	request_awaiter<T> awaitable(request &&r) noexcept    {return request_awaiter<T>(r);}
+
+	/*
+		Requests returned by topic methods may be awaited directly.
+			eg:  pleb::response r = co_await pleb::GET("svc/x");
+	*/
+	inline request_awaiter<response> operator co_await(auto_request &&r) noexcept    {return request_awaiter<response>(static_cast<request&>(r));}
+
+
+
+	template<typename T = void> class task;
+
+	namespace detail
+	{
+		/*
+			Promise functionality shared between task<T> and task<void>.
+		*/
+		class task_promise_base : public task_cancellation
+		{
+		public:
+			std::suspend_always initial_suspend() noexcept    {return {};}
+
+			struct final_awaiter
+			{
+				bool await_ready() const noexcept    {return false;}
+				void await_resume()      noexcept    {}
+
+				template<class Promise>
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+				{
+					auto &p = handle.promise();
+					p._finished.store(true, std::memory_order_release);
+					if (p._continuation) return p._continuation;
+
+					// Detached tasks destroy themselves upon completion.
+					if (p._abandoned.exchange(true, std::memory_order_acq_rel)) handle.destroy();
+					return std::noop_coroutine();
+				}
+			};
+			final_awaiter final_suspend() noexcept    {return {};}
+
+			void unhandled_exception() noexcept    {_error = std::current_exception();}
+
+
+		protected:
+			template<typename> friend class pleb::task;
+
+			std::coroutine_handle<> _continuation;
+			std::atomic<bool>       _abandoned = false;
+			std::atomic<bool>       _finished  = false;
+			std::exception_ptr      _error;
+
+			void _rethrow() const    {if (_error) std::rethrow_exception(_error);}
+		};
+
+		template<typename T>
+		class task_promise : public task_promise_base
+		{
+		public:
+			task<T> get_return_object() noexcept;
+
+			template<typename V>
+			void return_value(V &&v)    {_value.emplace(std::forward<V>(v));}
+
+			T result()                  {_rethrow(); return std::move(*_value);}
+
+		private:
+			std::optional<T> _value;
+		};
+
+		template<>
+		class task_promise<void> : public task_promise_base
+		{
+		public:
+			task<void> get_return_object() noexcept;
+
+			void return_void() noexcept    {}
+
+			void result()                  {_rethrow();}
+		};
+	}
+
+
+	/*
+		A minimal coroutine type which may await PLEB requests.
+			Tasks are lazy: they begin executing when awaited, started or detached.
+
+		A task may be awaited once, by another coroutine, if it has not been started.
+			Otherwise start() runs it until its first suspension, and the result
+			may be retrieved with get() once done() is true.
+
+		Destroying a task which has started but not finished detaches it;
+			it will run to completion and then destroy itself.
+	*/
+	template<typename T>
+	class task
+	{
+	public:
+		using promise_type = detail::task_promise<T>;
+		using handle_type  = std::coroutine_handle<promise_type>;
+
+
+	public:
+		task() noexcept                        : _handle(nullptr), _started(false) {}
+		~task()                                {_release();}
+
+		task(task &&o) noexcept                : _handle(o._handle), _started(o._started) {o._handle = nullptr;}
+		task &operator=(task &&o) noexcept     {if (this != &o) {_release(); _handle = o._handle; _started = o._started; o._handle = nullptr;} return *this;}
+
+		task(const task&) = delete;
+		task &operator=(const task&) = delete;
+
+
+		explicit operator bool() const noexcept    {return bool(_handle);}
+
+		// Check whether the task has run to completion.
+		bool done() const noexcept    {return _handle && _handle.promise()._finished.load(std::memory_order_acquire);}
+
+		// Begin executing the task, if it has not already started.
+		void start()                  {if (_handle && !_started) {_started = true; _handle.resume();}}
+
+		/*
+			Cancel the request the task is awaiting, and any it awaits later.
+				Services may notice and stop early; the task still runs to completion.
+		*/
+		void cancel() noexcept        {if (_handle) _handle.promise().cancel();}
+
+		/*
+			Get the result of a completed task.  Rethrows any exception it exited with.
+				Throws std::logic_error if the task has not completed.
+		*/
+		T get()
+		{
+			if (!done()) throw std::logic_error("pleb::task result requested before completion");
+			return _handle.promise().result();
+		}
+
+		/*
+			Start the task if necessary and relinquish it.
+				It will destroy itself when complete; its result is discarded.
+		*/
+		void detach()
+		{
+			if (!_handle) return;
+			start();
+			_detach();
+		}
+
+
+		/*
+			Await the task from another coroutine.
+		*/
+		auto operator co_await() && noexcept
+		{
+			struct awaiter
+			{
+				task &t;
+
+				bool await_ready() const noexcept    {return t.done();}
+
+				std::coroutine_handle<> await_suspend(std::coroutine_handle<> continuation)
+				{
+					if (t._started) throw std::logic_error("pleb::task awaited after being started");
+					t._started = true;
+					t._handle.promise()._continuation = continuation;
+					return t._handle;
+				}
+
+				T await_resume()    {return t._handle.promise().result();}
+			};
+			return awaiter{*this};
+		}
+
+
+	private:
+		friend promise_type;
+		handle_type _handle;
+		bool        _started;
+
+		explicit task(handle_type h) noexcept    : _handle(h), _started(false) {}
+
+		void _detach() noexcept
+		{
+			if (_handle.promise()._abandoned.exchange(true, std::memory_order_acq_rel)) _handle.destroy();
+			_handle = nullptr;
+		}
+		void _release() noexcept
+		{
+			if (!_handle) return;
+			if (_started && !_handle.promise()._continuation) _detach();
+			else {_handle.destroy(); _handle = nullptr;}
+		}
+	};
+
+
+	namespace detail
+	{
+		template<typename T>
+		task<T>    task_promise<T>::get_return_object() noexcept     {return task<T>(std::coroutine_handle<task_promise<T>>::from_promise(*this));}
+		inline
+		task<void> task_promise<void>::get_return_object() noexcept  {return task<void>(std::coroutine_handle<task_promise<void>>::from_promise(*this));}
+	}
+
+
+
+	namespace detail
+	{
+		/*
+			Run a coroutine service on its own copy of the request.
+				The copy holds the client, so it stays valid across suspension.
+				Thrown statuses become responses, as with other services;
+				other exceptions are reported as InternalServerError.
+		*/
+		template<typename Handler>
+		task<void> serve_coroutine(std::shared_ptr<Handler> handler, request req)
+		{
+			try                            {co_await (*handler)(req);}
+			catch (status s)               {req.respond(s);}
+			catch (statuses s)             {req.respond(s);}
+			catch (status_exception &e)    {req.respond(e.status);}
+			catch (...)                    {req.respond(statuses::InternalServerError, std::current_exception());}
+
+			// Default response if the handler did not respond.
+			if (!(req.features & flags::did_respond)) req.respond(statuses::NoContent);
+		}
+	}
+
+	template<typename P>
+	template<typename Handler, typename>
+	std::shared_ptr<service> topic_<P>::serve(
+		Handler       &&handler,
+		service_config  flags)
+	{
+		auto shared = std::make_shared<std::decay_t<Handler>>(std::forward<Handler>(handler));
+
+		return serve(service_function([shared = std::move(shared)](pleb::request &r)
+		{
+			// The coroutine's copy of the request answers the client, within any deadline.
+			pleb::request copy(r);
+			copy.exchange_client(r.claim_client());
+			detail::serve_coroutine(shared, std::move(copy)).detach();
+		}), flags);
+	}
+}
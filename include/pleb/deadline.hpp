@@ -0,0 +1,95 @@
+#pragma once
+
+
+#include <mutex>
+#include <atomic>
+
+#include "response.hpp"
+#include "timer_wheel.hpp"
+
+/*
+	Deadlines for requests whose response is deferred.
+
+	When a service claims the client of a request with a deadline, the client
+		is wrapped in a deadline_client registered with default_timer_wheel().
+		If the deadline passes first, the requester receives GatewayTimeout and
+		the original client is released; a later response is discarded.
+		The deadline_client then counts as cancelled.
+*/
+
+
+namespace pleb
+{
+	namespace detail
+	{
+		class deadline_client : public client, public timer_wheel::timer
+		{
+		public:
+			deadline_client(client_ptr next, const topic_path &topic, timer_wheel::clock::time_point deadline)
+				:
+				client([this](response &r) {_respond(r);}, flags::realtime),
+				_next(std::move(next)), _topic(topic)
+			{
+				default_timer_wheel().schedule(*this, deadline);
+			}
+
+			~deadline_client()    {default_timer_wheel().cancel(*this);}
+
+			// Cancelled upon timeout, or when the original client is cancelled.
+			bool is_cancelled() const noexcept override
+			{
+				if (client::is_cancelled()) return true;
+				std::lock_guard<std::mutex> lock(_mutex);
+				return _next && _next->is_cancelled();
+			}
+
+			void on_cancel(std::function<void()> callback) override
+			{
+				// The callback may be triggered both ways, but runs only once.
+				auto once = [fired = std::make_shared<std::atomic<bool>>(false), callback = std::move(callback)]()
+				{
+					if (!fired->exchange(true, std::memory_order_acq_rel)) callback();
+				};
+				client_ptr next;
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					next = _next;
+				}
+				if (next) next->on_cancel(once);
+				client::on_cancel(std::move(once));
+			}
+
+
+		protected:
+			void expire() override
+			{
+				if (_done.exchange(true, std::memory_order_acq_rel)) return;
+
+				client_ptr next;
+				{
+					std::lock_guard<std::mutex> lock(_mutex);
+					next = std::move(_next);
+				}
+				response timeout(_topic, statuses::GatewayTimeout);
+				next->deliver(timeout);
+				next.reset();
+				cancel();
+			}
+
+
+		private:
+			client_ptr         _next;
+			topic_path         _topic;
+			std::atomic<bool>  _done = false;
+			mutable std::mutex _mutex; // Guards _next, which is released upon timeout.
+
+			void _respond(response &r)
+			{
+				if (_done.exchange(true, std::memory_order_acq_rel)) return;
+
+				default_timer_wheel().cancel(*this);
+				_next->deliver(r);
+			}
+		};
+	}
+}
@@ -9,6 +9,8 @@
 	This is useful for implementing gateways and network communications.
 */
 
+#include <vector>
+
 #include "topic.hpp"
 #include "topic_impl.hpp"
 
@@ -23,8 +25,13 @@ namespace pleb
 			return root.subscribe([callback = std::move(callback)](const pleb::event &event)
 			{
 				if (event.filtering & flags::announce_receiver)
+				{
 					if (auto *ptr = event.value_cast<ScanResult>())
 						callback(*ptr);
+					// Receivers registered within an announcement_batch arrive together.
+					else if (auto *ptrs = event.value_cast<std::vector<ScanResult>>())
+						for (auto &ptr : *ptrs) callback(ptr);
+				}
 			},
 				flags::regular | handling);
 		}
@@ -56,6 +56,35 @@ namespace pleb
 	*/
 	using subscriber_function = std::function<void(const event&)>;
 
+	/*
+		Batch subscribers may be implemented as a function taking a span of events.
+			See publish_batch.
+	*/
+	using batch_subscriber_function = std::function<void(std::span<const event>)>;
+
+	/*
+		How a subscription receives events.
+			direct -- called by the publisher, or on the executor if pooled.
+			queued -- from a mailbox; see queued_subscription.
+			latest -- only the newest event is kept; see latest_subscription.
+	*/
+	enum class delivery_mode : uint8_t
+	{
+		direct,
+		queued,
+		latest,
+	};
+
+
+	namespace detail
+	{
+		// Counts resources losing their last subscription; cached observed() flags which are true are recomputed when it changes.
+		inline std::atomic<size_t> &subscription_generation() noexcept    {static std::atomic<size_t> generation = 0; return generation;}
+
+		// Counts subscriptions accepting announce_receiver; new receivers are only announced while there are some.
+		inline std::atomic<size_t> &announcement_listeners() noexcept     {static std::atomic<size_t> listeners = 0; return listeners;}
+	}
+
 
 	/*
 		Class for a registered subscription function which can receive reports.
@@ -63,12 +92,15 @@ namespace pleb
 	class subscription : public receiver
 	{
 	public:
-		const pleb::topic topic;
+		const pleb::topic   topic;
+		const delivery_mode delivery = delivery_mode::direct;
 
 
 	private:
 		template<class P> friend class topic_;
-		const subscriber_function func;
+		friend class consumer_group;
+		const subscriber_function       func;
+		const batch_subscriber_function batch_func;
 
 
 	public:
@@ -78,19 +110,105 @@ namespace pleb
 			subscriber_function &&_func,
 			service_config        flags = {})
 			:
-			receiver(flags), topic(_topic), func(std::move(_func)) {}
+			receiver(flags), topic(_topic), func(std::move(_func)) {_count(1);}
+
+		// A batch subscription receives single events as batches of one.
+		subscription(
+			const pleb::topic          &_topic,
+			batch_subscriber_function &&_func,
+			service_config              flags = {})
+			:
+			receiver(flags), topic(_topic),
+			func([this](const pleb::event &e) {batch_func(std::span<const pleb::event>(&e, 1));}),
+			batch_func(std::move(_func)) {_count(1);}
+
+		~subscription()    {_count(-1);}
+
+		// Check whether this subscription accepts events in batches.
+		bool is_batch() const noexcept    {return bool(batch_func);}
+
+
+	protected:
+		// Used by subscriptions with other delivery modes.
+		subscription(
+			const pleb::topic    &_topic,
+			subscriber_function &&_func,
+			service_config        flags,
+			delivery_mode         mode)
+			:
+			receiver(flags), topic(_topic), delivery(mode), func(std::move(_func)) {_count(1);}
+
+
+	private:
+		// Count this subscription at its resource; see resource_data::observed.
+		void _count(int delta) noexcept;
 	};
 
 
 
+	namespace detail
+	{
+		// Replace borrowed content in a copied event with a copy of its own.
+		inline void own_content(event &copy)
+		{
+			if (auto *view = std_any::any_cast<any_view>(&copy.value())) copy.value() = *view->value;
+		}
+
+		// Copy an event for delivery after the publisher returns, copying any borrowed content.
+		inline std::shared_ptr<const event> share_event(const event &msg)
+		{
+			auto copy = std::make_shared<event>(msg);
+			own_content(*copy);
+			return copy;
+		}
+	}
+
+
 	/*
-		An event relay is a special subscription that republishes messages.
-			It has no additional functionality at the moment.
+		An event relay is a special subscription that republishes events to another topic.
+			Events are passed on by reference while they are being delivered, so their
+			content is never copied.  Subscribers at the destination receive the original
+			event, or a view of it under the destination topic; see event_forwarding.
+			An event forwarded through more than max_hops relays, as happens when relays
+			form a cycle, is not forwarded further and the relay throws.
 	*/
 	class event_relay : public subscription
 	{
-	protected:
-		using subscription::subscription;
+	public:
+		const topic_path       destination;
+		const event_forwarding forwarding;
+
+		static constexpr size_t max_hops = 16;
+
+
+	public:
+		// Note this class will normally only be created by topic::forward_events().
+		event_relay(
+			const pleb::topic   &_topic,
+			topic_path           _destination,
+			event_forwarding     _forwarding,
+			subscription_config  flags = {})
+			:
+			subscription(_topic, [this](const pleb::event &e) {forward(e);}, flags),
+			destination(std::move(_destination)), forwarding(_forwarding) {}
+
+		// Publish an event to the destination.
+		void forward(const pleb::event &e) const
+		{
+			static thread_local size_t hops = 0;
+			if (hops >= max_hops) throw std::logic_error("Event forwarded through too many relays; they may form a cycle.");
+
+			struct hop {hop() noexcept {++hops;} ~hop() {--hops;}} counted;
+
+			if (forwarding == event_forwarding::original_topic) return destination.publish(e);
+
+			// Views refer to the original content, never to another view.
+			auto *borrowed = std_any::any_cast<detail::any_view>(&e.value());
+			pleb::event view(destination, e.status(), detail::any_view{borrowed ? borrowed->value : &e.value()},
+				e.filtering | e.requirements);
+			view.id = e.id;
+			destination.publish(view);
+		}
 	};
 
 
@@ -100,19 +218,19 @@ namespace pleb
 	template<typename SubPath>
 	std::shared_ptr<event_relay> topic_<SubPath>::forward_events(
 		topic_path          destination_topic,
-		subscription_config flags)
+		subscription_config flags,
+		event_forwarding    forwarding)
 	{
 		if (!(flags.filtering & pleb::flags::recursive) && is_ancestor_of(destination_topic))
 			throw std::logic_error("Forwarding events to a child topic would cause a stack overflow.");
 
-		return std::static_pointer_cast<event_relay>(
-			subscribe([destination_topic = std::move(destination_topic)](const pleb::event &event)
-		{
-			// Generate a copy of the event...
-			destination_topic.publish(
-				event.status(),
-				event.value(),
-				event.filtering | event.requirements);
-		}, flags));
+		auto &node = this->_realize();
+		if constexpr (type_can_be_null) null_topic_error::check(node, "can't subscribe", "(null topic)");
+
+		destination_topic.resolve();
+		auto relay = std::make_shared<event_relay>(topic(node), std::move(destination_topic), forwarding, flags);
+		node->insert_subscriber(relay);
+		_announce(relay);
+		return relay;
 	}
 }
@@ -0,0 +1,412 @@
+#pragma once
+
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <algorithm>
+
+/*
+	PLEB's optional thread pool.
+
+	PLEB itself imposes no queueing; receivers normally run on the thread
+		which publishes or requests.  Services and subscriptions configured
+		with flags::pooled run on the default executor instead, and any code
+		may post its own work to an executor.
+
+	Each worker owns a lock-free work-stealing deque.  Work posted by a
+		worker goes onto its own deque; work posted by other threads goes
+		to a worker's lock-free inbox and moves to the deque in batches.
+		Idle workers steal batches from the far end of other deques.
+		No mutex is involved, and idle workers sleep on an atomic.
+
+	A worker which waits for a response, as request::await does, runs other
+		jobs meanwhile, since the response may depend on a job queued behind
+		it.  So a pooled service may await another even with one worker.
+		Jobs run this way are nested in the waiting job's stack, so a pooled
+		receiver should not hold a lock while it awaits one which takes it.
+*/
+
+
+namespace pleb
+{
+	namespace detail
+	{
+		/*
+			A unit of work posted to an executor.
+		*/
+		class executor_job
+		{
+		public:
+			executor_job *next = nullptr; // Link used by job_inbox.
+
+			virtual ~executor_job() {}
+			virtual void run() = 0;
+		};
+
+		template<typename Function>
+		class executor_job_of final : public executor_job
+		{
+		public:
+			explicit executor_job_of(Function &&f)    : _function(std::move(f)) {}
+
+			void run() override    {_function();}
+
+		private:
+			Function _function;
+		};
+
+
+		/*
+			Chase-Lev work-stealing deque, after Lê et al (2013).
+				The owning worker pushes and pops at the bottom.
+				Any thread may steal from the top.
+		*/
+		class work_deque
+		{
+		public:
+			explicit work_deque(size_t capacity = 256)    : _top(0), _bottom(0), _array(new ring(capacity)) {}
+			~work_deque()
+			{
+				// Jobs remaining here are discarded.
+				for (auto t = _top.load(), b = _bottom.load(); t < b; ++t) delete _array.load()->get(t);
+				delete _array.load();
+			}
+
+			work_deque(const work_deque&) = delete;
+			void operator=(const work_deque&) = delete;
+
+
+			// Approximate number of jobs in the deque.
+			size_t size() const noexcept
+			{
+				auto b = _bottom.load(std::memory_order_relaxed), t = _top.load(std::memory_order_relaxed);
+				return (b > t) ? size_t(b - t) : 0;
+			}
+
+			// Push a job at the bottom.  Owner only.
+			void push(executor_job *job)
+			{
+				int64_t b = _bottom.load(std::memory_order_relaxed);
+				int64_t t = _top.load(std::memory_order_acquire);
+				ring   *a = _array.load(std::memory_order_relaxed);
+				if (b - t > int64_t(a->mask)) a = _grow(a, t, b);
+				a->put(b, job);
+				std::atomic_thread_fence(std::memory_order_release);
+				_bottom.store(b + 1, std::memory_order_relaxed);
+			}
+
+			// Pop the newest job from the bottom.  Owner only.
+			executor_job *pop() noexcept
+			{
+				int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+				ring   *a = _array.load(std::memory_order_relaxed);
+				_bottom.store(b, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				int64_t t = _top.load(std::memory_order_relaxed);
+
+				if (t > b) {_bottom.store(b + 1, std::memory_order_relaxed); return nullptr;}
+
+				executor_job *job = a->get(b);
+				if (t == b)
+				{
+					// Last job: race against thieves.
+					if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+						job = nullptr;
+					_bottom.store(b + 1, std::memory_order_relaxed);
+				}
+				return job;
+			}
+
+			// Take the oldest job from the top.  Any thread.
+			executor_job *steal() noexcept
+			{
+				while (true)
+				{
+					int64_t t = _top.load(std::memory_order_acquire);
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+					int64_t b = _bottom.load(std::memory_order_acquire);
+					if (t >= b) return nullptr;
+
+					executor_job *job = _array.load(std::memory_order_acquire)->get(t);
+					if (_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+						return job;
+				}
+			}
+
+
+		private:
+			struct ring
+			{
+				size_t                                           mask;
+				std::unique_ptr<std::atomic<executor_job*>[]> slots;
+
+				explicit ring(size_t capacity)    : mask(capacity - 1), slots(new std::atomic<executor_job*>[capacity]) {}
+
+				executor_job *get(int64_t i) const noexcept    {return slots[size_t(i) & mask].load(std::memory_order_relaxed);}
+				void put(int64_t i, executor_job *j) noexcept  {slots[size_t(i) & mask].store(j, std::memory_order_relaxed);}
+			};
+
+			alignas(64) std::atomic<int64_t> _top;
+			alignas(64) std::atomic<int64_t> _bottom;
+			std::atomic<ring*>                _array;
+
+			// Thieves may still be reading an outgrown ring; keep it until destruction.
+			std::vector<std::unique_ptr<ring>> _retired;
+
+			ring *_grow(ring *a, int64_t t, int64_t b)
+			{
+				ring *bigger = new ring(2 * (a->mask + 1));
+				for (int64_t i = t; i < b; ++i) bigger->put(i, a->get(i));
+				_retired.emplace_back(a);
+				_array.store(bigger, std::memory_order_release);
+				return bigger;
+			}
+		};
+
+
+		/*
+			Lock-free inbox accepting jobs from any thread.
+				Jobs are removed all at once, which any thread may do.
+		*/
+		class job_inbox
+		{
+		public:
+			job_inbox() noexcept    : _head(nullptr) {}
+			~job_inbox()            {for (auto *j = take_all(); j; ) {auto *n = j->next; delete j; j = n;}}
+
+			void push(executor_job *job) noexcept
+			{
+				job->next = _head.load(std::memory_order_relaxed);
+				while (!_head.compare_exchange_weak(job->next, job, std::memory_order_release, std::memory_order_relaxed)) {}
+			}
+
+			// Remove every job, returning a list ordered oldest first.
+			executor_job *take_all() noexcept
+			{
+				if (!_head.load(std::memory_order_relaxed)) return nullptr;
+				executor_job *job = _head.exchange(nullptr, std::memory_order_acquire), *prior = nullptr;
+				while (job) {auto *n = job->next; job->next = prior; prior = job; job = n;}
+				return prior;
+			}
+
+		private:
+			std::atomic<executor_job*> _head;
+		};
+	}
+
+
+	/*
+		A work-stealing thread pool.
+			Jobs are callable objects taking no arguments.
+			Exceptions escaping a job are discarded.
+
+		Each worker runs its own jobs newest-first (LIFO, the default, which
+			favors cache locality) or oldest-first (FIFO, which favors fairness).
+			Thieves always take the oldest jobs.
+	*/
+	class executor
+	{
+	public:
+		enum class order : uint8_t
+		{
+			lifo,
+			fifo,
+		};
+
+		struct config
+		{
+			size_t threads     = 0;           // Zero selects the hardware concurrency.
+			order  local_order = order::lifo; // Order in which workers run their own jobs.
+			size_t steal_batch = 32;          // Most jobs moved by one steal (at most half the victim's).
+		};
+
+
+	public:
+		executor()    : executor(config{}) {}
+
+		explicit executor(config c)
+			:
+			_config(c), _next(0), _sleepers(0), _epoch(0), _stopping(false)
+		{
+			if (!_config.threads)     _config.threads = std::max(1u, std::thread::hardware_concurrency());
+			if (!_config.steal_batch) _config.steal_batch = 1;
+
+			_workers.reserve(_config.threads);
+			for (size_t i = 0; i < _config.threads; ++i) _workers.emplace_back(new worker(this, i));
+			for (auto &w : _workers) w->thread = std::thread([this, w = w.get()]() {_work(*w);});
+		}
+
+		// Stops the workers after all posted jobs have run.
+		~executor()
+		{
+			_stopping.store(true, std::memory_order_seq_cst);
+			_epoch.fetch_add(1, std::memory_order_release);
+			_epoch.notify_all();
+			for (auto &w : _workers) w->thread.join();
+		}
+
+		executor(const executor&) = delete;
+		void operator=(const executor&) = delete;
+
+
+		/*
+			Run a function on some worker.
+				Called from a worker, the job goes to that worker's own deque.
+		*/
+		template<typename Function>
+		void post(Function &&function)
+		{
+			_post(new detail::executor_job_of<std::decay_t<Function>>(std::forward<Function>(function)));
+		}
+
+		// Number of worker threads.
+		size_t thread_count() const noexcept    {return _workers.size();}
+
+		// Check whether the calling thread is one of this executor's workers.
+		bool running_in_this_thread() const noexcept    {return _current && _current->owner == this;}
+
+		/*
+			Run other jobs on the calling thread until done() is true.
+				Returns false at once, without waiting, if the caller is not a worker.
+				Otherwise the worker yields, then naps, while it finds no jobs.
+		*/
+		template<typename Predicate>
+		static bool help_until(const Predicate &done)
+		{
+			if (!_current) return false;
+			for (unsigned idle = 0; !done(); )
+			{
+				if (auto *job = _current->owner->_find(*_current)) {_run(job); idle = 0;}
+				else if (++idle < 64) std::this_thread::yield();
+				else std::this_thread::sleep_for(std::chrono::microseconds(100));
+			}
+			return true;
+		}
+
+
+	private:
+		struct alignas(64) worker
+		{
+			executor          *owner;
+			size_t             index;
+			detail::work_deque deque;
+			detail::job_inbox  inbox;
+			std::thread        thread;
+
+			worker(executor *o, size_t i)    : owner(o), index(i) {}
+		};
+
+		config                               _config;
+		std::vector<std::unique_ptr<worker>> _workers;
+
+		alignas(64) std::atomic<size_t>      _next;
+		alignas(64) std::atomic<uint32_t>    _sleepers;
+		std::atomic<uint32_t>                _epoch;
+		std::atomic<bool>                    _stopping;
+
+		static inline thread_local worker *_current = nullptr;
+
+
+		void _post(detail::executor_job *job)
+		{
+			if (running_in_this_thread()) _current->deque.push(job);
+			else _workers[_next.fetch_add(1, std::memory_order_relaxed) % _workers.size()]->inbox.push(job);
+
+			// Wake a sleeping worker.  Pairs with the fence in _work.
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if (_sleepers.load(std::memory_order_relaxed))
+			{
+				_epoch.fetch_add(1, std::memory_order_release);
+				_epoch.notify_one();
+			}
+		}
+
+		static void _run(detail::executor_job *job) noexcept
+		{
+			try         {job->run();}
+			catch (...) {}
+			delete job;
+		}
+
+		detail::executor_job *_pop_local(worker &w) noexcept
+		{
+			return (_config.local_order == order::lifo) ? w.deque.pop() : w.deque.steal();
+		}
+
+		// Move a list of jobs onto this worker's deque, returning false if there were none.
+		static bool _adopt(worker &w, detail::executor_job *list)
+		{
+			if (!list) return false;
+			while (list) {auto *n = list->next; list->next = nullptr; w.deque.push(list); list = n;}
+			return true;
+		}
+
+		detail::executor_job *_find(worker &w)
+		{
+			if (auto *job = _pop_local(w)) return job;
+
+			// Collect posts from other threads.
+			if (_adopt(w, w.inbox.take_all())) return _pop_local(w);
+
+			// Steal a batch from another worker, beginning with the next one.
+			const size_t n = _workers.size();
+			for (size_t k = 1; k < n; ++k)
+			{
+				worker &victim = *_workers[(w.index + k) % n];
+
+				size_t batch = std::min(_config.steal_batch, std::max<size_t>(victim.deque.size() / 2, 1));
+				if (auto *job = victim.deque.steal())
+				{
+					while (--batch) if (auto *more = victim.deque.steal()) w.deque.push(more); else break;
+					return job;
+				}
+				if (_adopt(w, victim.inbox.take_all())) return _pop_local(w);
+			}
+			return nullptr;
+		}
+
+		void _work(worker &w)
+		{
+			_current = &w;
+			while (true)
+			{
+				if (auto *job = _find(w)) {_run(job); continue;}
+
+				// Announce sleep, then look once more before waiting.
+				_sleepers.fetch_add(1, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+				auto epoch = _epoch.load(std::memory_order_acquire);
+
+				if (auto *job = _find(w))
+				{
+					_sleepers.fetch_sub(1, std::memory_order_relaxed);
+					_run(job);
+					continue;
+				}
+				if (_stopping.load(std::memory_order_acquire))
+				{
+					_sleepers.fetch_sub(1, std::memory_order_relaxed);
+					break;
+				}
+
+				_epoch.wait(epoch, std::memory_order_acquire);
+				_sleepers.fetch_sub(1, std::memory_order_relaxed);
+			}
+			_current = nullptr;
+		}
+	};
+
+
+	/*
+		The executor used by receivers configured with flags::pooled.
+			It is started on first use, with one worker per hardware thread.
+	*/
+	inline executor &default_executor()
+	{
+		static executor instance; return instance;
+	}
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+#include "coop/pool.hpp"
+#include "executor.hpp"
+
+/*
+	Parallel fan-out; see topic::fan_out.
+
+	A topic with very many subscribers may have its events delivered in
+		parallel.  Its subscriber pool is divided by slot position into one
+		part per executor worker, plus one for the publisher.  The parts are
+		claimed from a shared counter by the publisher and by jobs posted to
+		the executor; the publisher returns once every part has been visited.
+
+	Because the publisher claims parts too, it never waits on a job which has
+		not started.  This keeps fan-out safe on the executor's own workers.
+*/
+
+
+namespace pleb
+{
+	namespace detail
+	{
+		/*
+			Call function(element, part) with each element of a pool, dividing the pool into
+				at most a number of parts visited in parallel on an executor.
+				Returns after every part is visited.
+		*/
+		template<typename T, typename Function>
+		void parallel_visit(const coop::unmanaged::pool<T> &pool, size_t parts, executor &exec, const Function &function)
+		{
+			struct state
+			{
+				std::atomic<size_t> next = 0, done = 0;
+			};
+
+			const size_t capacity = pool.capacity();
+			parts = std::clamp<size_t>(parts, 1, capacity);
+
+			auto shared = std::make_shared<state>();
+			auto visit_parts = [&pool, &function, parts, capacity](state &s)
+			{
+				for (size_t part; (part = s.next.fetch_add(1, std::memory_order_relaxed)) < parts;)
+				{
+					// Receivers handle their own exceptions; anything else is discarded, as by the executor.
+					try
+					{
+						pool.visit_range(capacity * part / parts, capacity * (part + 1) / parts,
+							[&function, part](const std::shared_ptr<T> &element) {function(element, part);});
+					}
+					catch (...) {}
+					s.done.fetch_add(1, std::memory_order_release);
+					s.done.notify_one();
+				}
+			};
+
+			// Jobs which start after every part is claimed return without touching the pool.
+			for (size_t i = 1; i < parts; ++i) exec.post([shared, visit_parts] {visit_parts(*shared);});
+			visit_parts(*shared);
+
+			for (size_t done; (done = shared->done.load(std::memory_order_acquire)) < parts;) shared->done.wait(done);
+		}
+	}
+}
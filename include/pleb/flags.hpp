@@ -145,11 +145,30 @@ namespace pleb
 					as long as they are not scoped or immediate.
 			*/
 
+			/*
+				[pooled] is a receiver setting rather than a message requirement.
+					Pooled services and subscriptions run on pleb::default_executor()
+					instead of the requesting or publishing thread.
+					Immediate messages are still handled synchronously.
+
+				[coalescing] is also a receiver setting.  While a safe request without
+					a value is in progress at a coalescing service, identical requests
+					(same method and topic) await its response instead of calling the
+					service again.  See single_flight.hpp.
+
+				[caching] is also a receiver setting.  Successful responses to GET and HEAD
+					are kept and reused until an event is published to their topic or a
+					mutating request passes through the service.  See response_cache.hpp.
+			*/
+
 			no_copying = (1 << 15),
 			no_moving  = (1 << 14),
 
+			caching    = (1 << 12), // service answers repeated GET and HEAD requests from memory
 			immediate  = (1 << 11), // prevents request::defer, may afford optimizations
 			realtime   = (1 << 10), // supported by std::future/async/await response handling
+			pooled     = (1 << 9),  // receiver runs its handler on the default executor
+			coalescing = (1 << 8),  // service shares one response among identical safe requests
 
 			// By default, receivers support no special handling.
 			no_special_handling = 0,
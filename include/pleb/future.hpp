@@ -0,0 +1,367 @@
+#pragma once
+
+
+#include <atomic>
+#include <vector>
+#include <optional>
+#include <exception>
+
+#include "response.hpp"
+
+/*
+	PLEB's own future type, a lightweight alternative to std::future.
+
+	The shared state is a client holding the response, so a request
+		issued with a pleb::future costs a single allocation.
+		Producer and consumer synchronize on one atomic word;
+		there is no mutex or condition variable.
+
+	Continuations may be attached with then(), which runs them on the
+		responding thread (or posts them to an executor) instead of
+		parking a thread to wait for the response.
+*/
+
+
+namespace pleb
+{
+	template<typename T> class future;
+
+
+	namespace detail
+	{
+		// Whether a response value can be extracted from std::any as T.
+		template<typename T> struct any_storable                          : std::is_copy_constructible<T> {};
+		template<typename T> struct any_storable<std::vector<future<T>>> : std::false_type {};
+
+		/*
+			Shared state of a pleb::future.
+				Ownership is shared between the future and the producer,
+				which is either a client reference or a manual completion.
+				The state is deleted when both have released it.
+		*/
+		template<typename T>
+		class future_state : public client
+		{
+		public:
+			using continuation = std::function<void()>;
+
+			enum : uint8_t
+			{
+				writing    = 1, // A producer has claimed the right to complete the state.
+				ready      = 2, // A value or exception is available.
+				continuing = 4, // A continuation has been attached.
+			};
+
+
+		public:
+			// Create a state owned by one future and one producer.
+			static future_state *create()    {return new future_state();}
+
+			/*
+				Produce a client reference to this state, taking over the producer's ownership.
+					The shared_ptr control block is placed inside this state.
+					If the last reference is released without a response, the state breaks.
+			*/
+			client_ptr share_producer()
+			{
+				return client_ptr(static_cast<client*>(this), [](client*) noexcept {},
+					control_block_allocator<char, future_state>(this));
+			}
+
+			/*
+				Producer interface.  Only the first completion has any effect.
+			*/
+			template<typename... Args>
+			void set_value(Args&&... args)
+			{
+				if (!_begin_write()) return;
+				try              {_value.emplace(std::forward<Args>(args)...);}
+				catch (...)      {_error = std::current_exception();}
+				_finish_write();
+			}
+			void set_exception(std::exception_ptr e)
+			{
+				if (!_begin_write()) return;
+				_error = std::move(e);
+				_finish_write();
+			}
+
+			// Release the producer's ownership, breaking the state if it never completed.
+			void release_producer() noexcept
+			{
+				set_exception(std::make_exception_ptr(std::future_error(std::future_errc::broken_promise)));
+				release();
+			}
+
+			/*
+				Consumer interface.
+			*/
+			bool is_ready() const noexcept    {return _flags.load(std::memory_order_acquire) & ready;}
+
+			// Workers run other jobs while they wait; see executor.hpp.
+			void wait() const noexcept
+			{
+				if (executor::help_until([this] {return is_ready();})) return;
+				for (auto f = _flags.load(std::memory_order_acquire); !(f & ready); f = _flags.load(std::memory_order_acquire))
+					_flags.wait(f, std::memory_order_acquire);
+			}
+
+			T get()
+			{
+				wait();
+				if (_error) std::rethrow_exception(_error);
+				return std::move(*_value);
+			}
+
+			// Attach a continuation, running it immediately if the state is ready.
+			void set_continuation(continuation &&c)
+			{
+				_continuation = std::move(c);
+				if (_flags.fetch_or(continuing, std::memory_order_acq_rel) & ready) _run_continuation();
+			}
+
+			void release() noexcept    {if (_refs.fetch_sub(1, std::memory_order_acq_rel) == 1) delete this;}
+
+
+		private:
+			template<typename, class> friend struct control_block_allocator;
+
+			std::atomic<int>     _refs  = 2;
+			std::atomic<uint8_t> _flags = 0;
+			std::optional<T>     _value;
+			std::exception_ptr   _error;
+			continuation         _continuation;
+
+			alignas(std::max_align_t) unsigned char _cb_buffer[8*sizeof(void*)];
+
+			future_state()
+				:
+				client([this](response &r) {_receive(r);}, flags::realtime) {}
+
+			void _cb_released() noexcept    {release_producer();}
+
+			void _receive(response &r)
+			{
+				// Values which std::any cannot hold (eg, combined futures) are only produced directly.
+				if      constexpr (std::is_same_v<T, response>) set_value(std::move(r));
+				else if constexpr (!any_storable<T>::value)     set_exception(std::make_exception_ptr(std_any::bad_any_cast()));
+				else try {set_value(r.move_as<T>());} catch (std_any::bad_any_cast) {set_exception(std::current_exception());}
+			}
+
+			bool _begin_write() noexcept    {return !(_flags.fetch_or(writing, std::memory_order_acquire) & writing);}
+			void _finish_write()
+			{
+				auto prior = _flags.fetch_or(ready, std::memory_order_acq_rel);
+				_flags.notify_all();
+				if (prior & continuing) _run_continuation();
+			}
+
+			void _run_continuation()    {auto c = std::move(_continuation); c();}
+		};
+	}
+
+
+	/*
+		A future holding the eventual response to a request.
+			Like std::future it is movable but not copyable.
+
+		Unless T is pleb::response, status is discarded and a response
+			of incompatible type becomes a bad_any_cast exception.
+	*/
+	template<typename T = response>
+	class future
+	{
+	public:
+		using value_type = T;
+		using state_type = detail::future_state<T>;
+
+
+	public:
+		future()  noexcept                       : _state(nullptr) {}
+		~future() noexcept                       {reset();}
+
+		future(future &&o) noexcept              : _state(o._state) {o._state = nullptr;}
+		future &operator=(future &&o) noexcept   {if (this != &o) {reset(); _state = o._state; o._state = nullptr;} return *this;}
+
+		future(const future&) = delete;
+		future &operator=(const future&) = delete;
+
+
+		/*
+			Create a future and the client which will fulfill it.
+				The client may be passed to request::issue or any other producer.
+		*/
+		static future create(client_ptr *producer)
+		{
+			future f(state_type::create());
+			if (producer) *producer = f._state->share_producer();
+			else          f._state->release_producer();
+			return f;
+		}
+
+
+		// Adopt one reference to a shared state.  Used by when_all and co.
+		explicit future(state_type *state) noexcept    : _state(state) {}
+
+
+		// Check whether this future refers to a shared state.
+		bool valid()    const noexcept    {return _state;}
+
+		// Check whether the response has arrived.
+		bool is_ready() const noexcept    {return _state && _state->is_ready();}
+
+		// Block until the response has arrived.
+		void wait()     const             {_check(); _state->wait();}
+
+		/*
+			Wait for the response and return it, invalidating this future.
+				Throws std::future_error if the client was released unanswered.
+		*/
+		T get()
+		{
+			_check();
+			future hold = std::move(*this);
+			return hold._state->get();
+		}
+
+		/*
+			Attach a continuation, invalidating this future.
+				The continuation is invoked with the ready future, either immediately
+				(if it is already ready) or on the thread that provides the response.
+
+			The second variant posts the continuation to an executor instead.
+				Any object with a post(callable) method may serve as an executor.
+		*/
+		template<typename Continuation>
+		void then(Continuation &&continuation)
+		{
+			_check();
+			state_type *s = _state; _state = nullptr;
+			s->set_continuation([s, c = std::forward<Continuation>(continuation)]() mutable
+			{
+				c(future(s));
+			});
+		}
+
+		template<typename Executor, typename Continuation>
+		void then(Executor &executor, Continuation &&continuation)
+		{
+			then([&executor, c = std::forward<Continuation>(continuation)](future f) mutable
+			{
+				executor.post([f = std::make_shared<future>(std::move(f)), c = std::move(c)]() mutable
+				{
+					c(std::move(*f));
+				});
+			});
+		}
+
+		/*
+			Release the shared state without waiting.
+				If the response has not arrived, the request is cancelled.
+		*/
+		void reset() noexcept
+		{
+			if (!_state) return;
+			if (!_state->is_ready()) _state->cancel();
+			_state->release();
+			_state = nullptr;
+		}
+
+		/*
+			Cancel the request and release the shared state, invalidating this future.
+				Services may notice and stop early; see client::on_cancel.
+		*/
+		void cancel() noexcept    {reset();}
+
+
+	private:
+		template<typename> friend class future;
+		state_type *_state;
+
+		void _check() const    {if (!_state) throw std::future_error(std::future_errc::no_state);}
+	};
+
+
+
+	/*
+		Result of when_any: the index of the first future to become ready,
+			and that future itself.
+	*/
+	template<typename T>
+	struct when_any_result
+	{
+		size_t    index;
+		future<T> result;
+	};
+
+	/*
+		Combine several futures, as may result from fanned-out requests.
+			when_all becomes ready when every input is ready.
+			when_any becomes ready when the first input is ready.
+		The input futures are consumed.  No thread is blocked while waiting.
+	*/
+	template<typename T>
+	future<std::vector<future<T>>> when_all(std::vector<future<T>> inputs)
+	{
+		using result_t = std::vector<future<T>>;
+
+		struct join
+		{
+			result_t                         results;
+			std::atomic<size_t>              remaining;
+			detail::future_state<result_t>  *output;
+
+			join(size_t n, detail::future_state<result_t> *o)    : results(n), remaining(n), output(o) {}
+
+			void arrive(size_t i, future<T> &&f)
+			{
+				results[i] = std::move(f);
+				if (remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) finish();
+			}
+			void finish()
+			{
+				output->set_value(std::move(results));
+				output->release();
+			}
+		};
+
+		auto *output = detail::future_state<result_t>::create();
+		future<result_t> combined(output);
+
+		auto shared = std::make_shared<join>(inputs.size(), output);
+		if (inputs.empty()) {shared->finish(); return combined;}
+
+		for (size_t i = 0; i < inputs.size(); ++i)
+			inputs[i].then([shared, i](future<T> f) {shared->arrive(i, std::move(f));});
+
+		return combined;
+	}
+
+	template<typename T>
+	future<when_any_result<T>> when_any(std::vector<future<T>> inputs)
+	{
+		using result_t = when_any_result<T>;
+
+		struct race
+		{
+			detail::future_state<result_t> *output;
+
+			race(detail::future_state<result_t> *o)    : output(o) {}
+			~race()                                     {output->release_producer();}
+		};
+
+		auto *output = detail::future_state<result_t>::create();
+		future<result_t> combined(output);
+
+		auto shared = std::make_shared<race>(output);
+		for (size_t i = 0; i < inputs.size(); ++i)
+			inputs[i].then([shared, i](future<T> f) {shared->output->set_value(result_t{i, std::move(f)});});
+
+		return combined;
+	}
+
+
+
+	template<typename T>
+	client_ref::client_ref(pleb::future<T> *f)    {if (f) *f = pleb::future<T>::create(this);}
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+
+#include <atomic>
+#include <memory>
+#include <optional>
+#include <cstdint>
+#include <bit>
+#include <algorithm>
+
+#include "resource_node.hpp"
+
+/*
+	Event histories; see topic::record.
+
+	An event_history keeps the last events published within a subtree in a
+		fixed ring, numbered in order of recording.  A publisher claims a
+		sequence number with one atomic increment and swaps a copy of its
+		event into that slot, reusing the old entry's storage when no reader
+		holds it.  Readers share entries, which don't change while shared,
+		and replay the ring from any sequence number still in it.
+
+	This serves as a flight recorder for debugging, and lets late consumers
+		catch up with topic::subscribe_replay.  Announcements are not recorded,
+		nor are events whose content may not be copied (flags::no_copying).
+*/
+
+
+namespace pleb
+{
+	/*
+		A ring of the events most recently published within a subtree.
+	*/
+	class event_history
+	{
+	public:
+		using sequence_t = uint64_t;
+
+		const size_t capacity; // Rounded up to a power of two.
+
+
+	public:
+		// Note this class will normally only be created by topic::record().
+		event_history(resource_node_ptr root, size_t _capacity)
+			:
+			capacity(std::bit_ceil(std::max<size_t>(_capacity, 1))), _root(std::move(root)), _ring(new slot[capacity])
+			{_live().fetch_add(1, std::memory_order_relaxed);}
+
+		~event_history()    {_live().fetch_sub(1, std::memory_order_relaxed); resource_data::_released(_root->_history, _root->_records);}
+
+		event_history(const event_history&) = delete;
+		void operator=(const event_history&) = delete;
+
+		// Sequence number the next event will receive.
+		sequence_t next()   const noexcept    {return _next.load(std::memory_order_acquire);}
+
+		// Sequence number of the oldest event which may still be in the ring.
+		sequence_t oldest() const noexcept    {auto n = next(); return (n > capacity) ? n - capacity : 0;}
+
+		/*
+			Record an event published to a topic, returning its sequence number.
+				The topic is given only if it differs from the event's, as when relayed.
+		*/
+		sequence_t record(const event &e, const topic_path *published = nullptr);
+
+		/*
+			Visit recorded events in order, from a sequence number up to next().
+				The callback takes the event and the topic it was published to.
+				Events overwritten by newer ones are skipped, as are those still
+				being recorded.  Returns the number of events visited.
+		*/
+		template<typename Callback>
+		size_t replay(sequence_t from, const Callback &callback) const;
+
+		// Check whether any histories exist, so publishers can skip the search.
+		static bool any_live() noexcept    {return _live().load(std::memory_order_relaxed);}
+
+		// Find the nearest history covering a resource, if any.
+		static std::shared_ptr<event_history> find(const resource_node_ptr &node);
+
+
+	private:
+		struct entry
+		{
+			sequence_t                sequence;
+			pleb::event               event;
+			std::optional<topic_path> published;
+
+			entry(sequence_t s, const pleb::event &e)    : sequence(s), event(e) {}
+
+			const topic_path &topic() const noexcept    {return published ? *published : event.topic;}
+		};
+		using slot = std::atomic<std::shared_ptr<entry>>;
+
+		const resource_node_ptr  _root; // Kept so the subtree stays recorded.
+		std::unique_ptr<slot[]>  _ring;
+		std::atomic<sequence_t>  _next = 0;
+
+		static std::atomic<size_t> &_live() noexcept    {static std::atomic<size_t> live = 0; return live;}
+	};
+
+
+	inline std::shared_ptr<event_history> event_history::find(const resource_node_ptr &node)
+	{
+		// Ancestors are kept alive by the resource.
+		for (auto *n = node.get(); n; n = n->parent().get())
+			if (n->_records.load(std::memory_order_relaxed))
+				if (auto h = n->_history.load(std::memory_order_acquire).lock()) return h;
+		return nullptr;
+	}
+
+	inline event_history::sequence_t event_history::record(const event &e, const topic_path *published)
+	{
+		sequence_t sequence = _next.fetch_add(1, std::memory_order_acq_rel);
+		auto      &s        = _ring[sequence & (capacity - 1)];
+
+		// Take the slot's entry.  If no reader holds it, reuse its storage for the new event.
+		auto prior = s.exchange(nullptr, std::memory_order_acquire), recorded = prior;
+		if (prior && prior->sequence > sequence)
+		{
+			// Lapped by a newer publisher, whose event goes back unless the slot was refilled.
+			std::shared_ptr<entry> empty;
+			s.compare_exchange_strong(empty, std::move(prior), std::memory_order_release, std::memory_order_relaxed);
+			return sequence;
+		}
+		if (recorded && recorded.use_count() == 1)
+		{
+			recorded->sequence = sequence;
+			recorded->event    = e;
+		}
+		else recorded = std::make_shared<entry>(sequence, e);
+
+		detail::own_content(recorded->event);
+		if (published) recorded->published = *published;
+		else           recorded->published.reset();
+
+		// Another publisher may have filled the slot meanwhile; the newer event stays.
+		prior = nullptr;
+		do if (prior && prior->sequence > sequence) break;
+		while (!s.compare_exchange_weak(prior, recorded, std::memory_order_release, std::memory_order_relaxed));
+		return sequence;
+	}
+
+	template<typename Callback>
+	size_t event_history::replay(sequence_t from, const Callback &callback) const
+	{
+		sequence_t end = next();
+		size_t     n   = 0;
+		for (sequence_t i = std::max(from, (end > capacity) ? end - capacity : 0); i < end; ++i)
+		{
+			auto e = _ring[i & (capacity - 1)].load(std::memory_order_acquire);
+			if (!e || e->sequence != i) continue;
+			callback(e->event, e->topic());
+			++n;
+		}
+		return n;
+	}
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <cstdint>
+#include <bit>
+#include <algorithm>
+
+#include "event.hpp"
+#include "executor.hpp"
+
+/*
+	Queued subscriptions; see topic::subscribe_queued.
+
+	A queued subscription does not run on the publishing thread.  Events are
+		placed in the subscription's bounded mailbox and delivered in order
+		on the default executor, or by a consumer thread calling drain().
+		Each event is shared immutably among all mailboxes it is placed in.
+
+	When a mailbox is full, its overflow policy applies; see overflow_policy.
+*/
+
+
+namespace pleb
+{
+	namespace detail
+	{
+		/*
+			Bounded ring, after Vyukov's bounded MPMC queue.
+				Publishers push; the consumer pops, as do publishers evicting old items.
+		*/
+		template<typename T>
+		class bounded_ring
+		{
+		public:
+			explicit bounded_ring(size_t capacity)
+				:
+				_mask(std::bit_ceil(std::max<size_t>(capacity, 2)) - 1), _slots(new slot[_mask + 1])
+			{
+				for (size_t i = 0; i <= _mask; ++i) _slots[i].sequence.store(i, std::memory_order_relaxed);
+			}
+
+			bounded_ring(const bounded_ring&) = delete;
+			void operator=(const bounded_ring&) = delete;
+
+			size_t capacity() const noexcept    {return _mask + 1;}
+
+			// Approximate number of waiting items.
+			size_t size() const noexcept
+			{
+				size_t t = _tail.load(), h = _head.load();
+				return (t > h) ? t - h : 0;
+			}
+
+			// Push an item, unless the ring is full.  The item is moved only on success.
+			bool try_push(T &item) noexcept
+			{
+				size_t pos = _tail.load(std::memory_order_relaxed);
+				slot  *s;
+				while (true)
+				{
+					s = &_slots[pos & _mask];
+					auto diff = intptr_t(s->sequence.load(std::memory_order_acquire)) - intptr_t(pos);
+					if (diff == 0)
+					{
+						if (_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) break;
+					}
+					else if (diff < 0) return false;
+					else pos = _tail.load(std::memory_order_relaxed);
+				}
+				s->value = std::move(item);
+				s->sequence.store(pos + 1, std::memory_order_release);
+				return true;
+			}
+
+			// Pop the oldest item, unless the ring is empty.
+			bool try_pop(T &item) noexcept
+			{
+				size_t pos = _head.load(std::memory_order_relaxed);
+				slot  *s;
+				while (true)
+				{
+					s = &_slots[pos & _mask];
+					auto diff = intptr_t(s->sequence.load(std::memory_order_acquire)) - intptr_t(pos + 1);
+					if (diff == 0)
+					{
+						if (_head.compare_exchange_weak(pos, pos + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) break;
+					}
+					else if (diff < 0) return false;
+					else pos = _head.load(std::memory_order_relaxed);
+				}
+				item = std::move(s->value);
+				s->sequence.store(pos + _mask + 1, std::memory_order_release);
+				return true;
+			}
+
+			// Pop and discard the oldest item, unless the ring is empty.
+			bool try_discard() noexcept    {T item; return try_pop(item);}
+
+
+		private:
+			struct slot
+			{
+				std::atomic<size_t> sequence;
+				T                   value;
+			};
+
+			const size_t            _mask;
+			std::unique_ptr<slot[]> _slots;
+
+			alignas(64) std::atomic<size_t> _tail = 0;
+			alignas(64) std::atomic<size_t> _head = 0;
+		};
+
+		// Ring of events shared among mailboxes.
+		using event_ring = bounded_ring<std::shared_ptr<const event>>;
+	}
+
+
+	/*
+		A subscription whose events wait in a bounded mailbox.
+			Events are delivered one at a time, in the order they were queued.
+	*/
+	class queued_subscription : public subscription
+	{
+	public:
+		const overflow_policy overflow;
+
+
+	public:
+		// Note this class will normally only be created by topic::subscribe_queued().
+		queued_subscription(
+			const pleb::topic   &_topic,
+			subscriber_function &&_func,
+			mailbox_config        config,
+			subscription_config   flags = {})
+			:
+			subscription(_topic, [this](const pleb::event &e) {enqueue(detail::share_event(e));}, flags, delivery_mode::queued),
+			overflow(config.overflow), _consumer(std::move(_func)), _ring(config.capacity), _manual(config.manual) {}
+
+		// Place an event in the mailbox, applying the overflow policy if it is full.
+		void enqueue(std::shared_ptr<const event> e)
+		{
+			while (!_ring.try_push(e)) switch (overflow)
+			{
+			case overflow_policy::drop_newest:
+				_dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+
+			case overflow_policy::drop_oldest:
+				if (_ring.try_discard()) _dropped.fetch_add(1, std::memory_order_relaxed);
+				break;
+
+			case overflow_policy::coalesce:
+				while (_ring.try_discard()) _dropped.fetch_add(1, std::memory_order_relaxed);
+				break;
+
+			case overflow_policy::block:
+				// On the executor, help drain the mailbox rather than waiting on a worker.
+				if (_manual || !default_executor().running_in_this_thread() || !drain(1)) std::this_thread::yield();
+				break;
+			}
+			if (!_manual) _schedule();
+		}
+
+		/*
+			Deliver up to a number of waiting events on this thread.
+				Returns the number delivered.  Delivery is never concurrent:
+				while another thread is draining, this returns zero.
+		*/
+		size_t drain(size_t limit = ~size_t(0));
+
+		// Number of events waiting in the mailbox.
+		size_t pending() const noexcept    {return _ring.size();}
+
+		// Number of events discarded by the overflow policy.
+		size_t dropped() const noexcept    {return _dropped.load(std::memory_order_relaxed);}
+
+
+	private:
+		template<class P> friend class topic_;
+		const subscriber_function          _consumer;
+		detail::event_ring                 _ring;
+		const bool                         _manual;
+		std::atomic<bool>                  _scheduled = false, _draining = false;
+		std::atomic<size_t>                _dropped   = 0;
+		std::weak_ptr<queued_subscription> _self;
+
+		// Post a drain to the default executor unless one is waiting.
+		void _schedule()
+		{
+			if (_scheduled.load() || _scheduled.exchange(true)) return;
+
+			if (auto self = _self.lock())
+				default_executor().post([self = std::move(self)] {self->_drain_scheduled();});
+			else
+				_scheduled.store(false);
+		}
+
+		// Deliver a mailbox's worth of events, then yield the worker if more remain.
+		void _drain_scheduled()
+		{
+			drain(_ring.capacity());
+			_scheduled.store(false);
+			if (_ring.size()) _schedule();
+		}
+	};
+
+
+	/*
+		Implementation of methods from the topic class.
+	*/
+	template<typename P> [[nodiscard]]
+	std::shared_ptr<queued_subscription> topic_<P>::subscribe_queued(
+		subscriber_function &&f,
+		mailbox_config        config,
+		subscription_config   flags)
+	{
+		auto &node = this->_realize();
+		if constexpr (type_can_be_null) null_topic_error::check(node, "can't subscribe", "(null topic)");
+
+		auto sub = std::make_shared<queued_subscription>(topic(node), std::move(f), config, flags);
+		sub->_self = sub;
+		node->insert_subscriber(sub);
+		_announce(sub);
+		_replay_retained(node, sub);
+		return sub;
+	}
+}
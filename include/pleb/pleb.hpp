@@ -3,6 +3,10 @@
 
 #include "topic_impl.hpp"
 
+#if __cpp_impl_coroutine >= 201902L
+	#include "coroutine.hpp"
+#endif
+
 
 /*
 	This header includes most other PLEB functions, and defines
@@ -26,6 +30,21 @@ namespace pleb
 		pleb::topic topic,
 		Args&&  ... args)                             {return topic.subscribe(std::forward<Args>(args)...);}
 
+	template<typename... Args> [[nodiscard]]
+	std::shared_ptr<queued_subscription> subscribe_queued(
+		pleb::topic topic,
+		Args&&  ... args)                             {return topic.subscribe_queued(std::forward<Args>(args)...);}
+
+	template<typename... Args> [[nodiscard]]
+	std::shared_ptr<latest_subscription> subscribe_latest(
+		pleb::topic topic,
+		Args&&  ... args)                             {return topic.subscribe_latest(std::forward<Args>(args)...);}
+
+	template<typename... Args> [[nodiscard]]
+	std::shared_ptr<shared_subscription> subscribe_shared(
+		pleb::topic topic,
+		Args&&  ... args)                             {return topic.subscribe_shared(std::forward<Args>(args)...);}
+
 	template<typename... Args>
 	void                          publish(
 		const topic_path &topic,
@@ -43,6 +62,34 @@ namespace pleb
 		bound_service_function handler,
 		service_config         flags = {})            {return topic.serve(std::move(handler), flags);}
 
+	[[nodiscard]] inline
+	std::shared_ptr<service>      serve_batch(
+		topic                  topic,
+		batch_service_function handler,
+		service_config         flags = {})            {return topic.serve_batch(std::move(handler), flags);}
+
+	[[nodiscard]] inline
+	std::shared_ptr<service>      serve_group(
+		topic                  topic,
+		service_function       handler,
+		service_config         flags  = {},
+		balancing              policy = balancing::round_robin)    {return topic.serve_group(std::move(handler), flags, policy);}
+
+	[[nodiscard]] inline
+	std::shared_ptr<service>      serve_partitioned(
+		topic                         topic,
+		std::vector<service_function> shards,
+		size_t                        key_segment = 0,
+		service_config                flags       = flags::default_receiver_ignore)    {return topic.serve_partitioned(std::move(shards), key_segment, flags);}
+
+	template<typename Handler,
+		typename = std::enable_if_t<std::is_same_v<std::invoke_result_t<Handler&, pleb::request&>, pleb::task<void>>>>
+	[[nodiscard]]
+	std::shared_ptr<service>      serve(
+		topic                  topic,
+		Handler              &&handler,
+		service_config         flags = {})            {return topic.serve(std::forward<Handler>(handler), flags);}
+
 
 	/*
 		Names like pleb::GET can be used as constants to refer to REST methods
@@ -85,9 +132,10 @@ namespace pleb
 	std::shared_ptr<event_relay> forward_events(
 		pleb::topic         from,
 		pleb::topic_path    to,
-		subscription_config flags = {})
+		subscription_config flags      = {},
+		event_forwarding    forwarding = event_forwarding::destination_topic)
 	{
-		return from.forward_events(std::move(to), flags);
+		return from.forward_events(std::move(to), flags, forwarding);
 	}
 	[[nodiscard]] inline
 	std::shared_ptr<service_relay> forward_requests(
@@ -97,6 +145,20 @@ namespace pleb
 	{
 		return from.forward_requests(std::move(to), flags);
 	}
+	[[nodiscard]] inline
+	std::shared_ptr<retention> retain(
+		pleb::topic         topic,
+		size_t              max_topics)
+	{
+		return topic.retain(max_topics);
+	}
+	[[nodiscard]] inline
+	std::shared_ptr<event_history> record(
+		pleb::topic         topic,
+		size_t              capacity)
+	{
+		return topic.record(capacity);
+	}
 
 #undef PLEB_RESOURCE_VERB
 
@@ -1,9 +1,16 @@
 #pragma once
 
+#include <span>
 #include <future>
+#include <optional>
 #include <exception>
 
 #include "response.hpp"
+#include "future.hpp"
+#include "single_flight.hpp"
+#include "response_cache.hpp"
+#include "deadline.hpp"
+#include "admission.hpp"
 #include "method.hpp"
 
 /*
@@ -46,9 +53,13 @@ namespace pleb
 		using content::get;
 		using content::get_mutable;
 
+		using clock = std::chrono::steady_clock;
+
 
 	private:
-		client_ptr _client;
+		client_ptr                _client;
+		clock::time_point         _deadline = clock::time_point::max();
+		std::optional<topic_path> _requested; // Set when the request is redirected.
 
 
 	public:
@@ -71,10 +82,29 @@ namespace pleb
 
 		~request() noexcept    {}
 
+		request(const request&)            = default;
+		request(request&&)                 = default;
+		request &operator=(const request&) = default;
+		request &operator=(request&&)      = default;
+
 
 		// Request method from <method.h>.  Stored in the code field.
 		method method() const noexcept    {return pleb::method_enum(code);}
 
+		/*
+			The topic this request was first issued to.
+				A relay redirects requests to the topic of the service it leads to,
+				which topic then holds; the service may find the original here.
+		*/
+		const topic_path &requested_topic() const noexcept    {return _requested ? *_requested : topic;}
+
+		// Redirect this request to another topic, as a relay does, keeping requested_topic().
+		void redirect(const pleb::topic &destination)
+		{
+			if (!_requested) _requested.emplace(std::move(topic));
+			topic = destination;
+		}
+
 
 		/*
 			Issue this request without accepting any response.
@@ -88,12 +118,32 @@ namespace pleb
 		template<typename Response = pleb::response>
 		std::future<Response> async()                   {std::future<Response> f; issue(std::make_shared<client_promise<Response>>(&f)); return f;}
 
+		/*
+			Issue this request and deliver the reply through pleb::future.
+				This is lighter than async() and supports continuations.
+		*/
+		template<typename Response = pleb::response>
+		pleb::future<Response> send()                   {pleb::future<Response> f; issue(&f); return f;}
+
 		/*
 			Issue this request and return the response.
 				This may block if the service doesn't respond immediately.
+
+			The response is received by a client on the caller's stack, without
+				allocating memory.  Waiting only occurs if the service claims the
+				client and responds later.  Requests requiring immediate handling
+				skip reference counting and throw handling_unavailable if deferred.
 		*/
 		template<typename Response = pleb::response>
-		Response await()                                {return async<Response>().get();} // TODO elide std::future for immediate services
+		Response await()
+		{
+			detail::stack_client<Response> client;
+			const bool immediate = (requirements & flags::immediate);
+			issue_and_release(immediate ? client.share_unowned() : client.share());
+			if (immediate && !client.has_response())
+				throw handling_unavailable("Service deferred an immediate request", topic.path());
+			return client.get();
+		}
 
 
 		// Issue this request to its targeted resource.
@@ -104,6 +154,15 @@ namespace pleb
 
 		void issue()                     {topic.issue(*this);}
 
+		// Issue this request, then release this request's reference to the client.
+		//    Afterward the client is referenced only if the service claimed it.
+		void issue_and_release(client_ref client)
+		{
+			try                {issue(std::move(client));}
+			catch (...)        {_client.reset(); throw;}
+			_client.reset();
+		}
+
 
 
 		/*
@@ -117,11 +176,56 @@ namespace pleb
 			if (_client) _client->respond(topic, status, std::forward<T>(value), flags);
 		}
 
+		/*
+			Check whether the requester has cancelled, eg by dropping its pleb::future.
+				After claiming the client, services should ask the client instead.
+		*/
+		bool is_cancelled() const noexcept    {return _client && _client->is_cancelled();}
+
+		// Call a function if the requester cancels.  See client::on_cancel.
+		void on_cancel(std::function<void()> callback)    {if (_client) _client->on_cancel(std::move(callback));}
+
 		/*
 			Claim the client for this message.
 				Think of this as a promise to respond later.
+				If the request has a deadline, the client will receive
+				GatewayTimeout unless a response arrives before then.
+				Throws handling_unavailable if the client lives on the requester's
+				stack without reference counting, as for immediate await().
 		*/
-		client_ptr claim_client() noexcept    {return std::move(_client);}
+		client_ptr claim_client()
+		{
+			if (_client && !_client.use_count())
+				throw handling_unavailable("Can't claim the client of an immediate request", topic.path());
+			if (!has_deadline() || !_client || (requirements & flags::immediate)) return std::move(_client);
+			return std::make_shared<detail::deadline_client>(std::move(_client), topic, _deadline);
+		}
+
+		/*
+			Replace the client for this message, returning the prior client.
+				PLEB uses this to interpose on responses.
+		*/
+		client_ptr exchange_client(client_ptr client) noexcept    {std::swap(client, _client); return client;}
+
+
+		/*
+			Deadlines.  Past its deadline, a request is answered GatewayTimeout,
+				whether it is still waiting for a service or already claimed.
+				Services may check the remaining budget to shed work.
+		*/
+		request &set_deadline(clock::time_point deadline) noexcept    {_deadline = deadline; return *this;}
+		request &set_timeout(clock::duration timeout)                 {return set_deadline(clock::now() + timeout);}
+
+		clock::time_point deadline()     const noexcept    {return _deadline;}
+		bool              has_deadline() const noexcept    {return _deadline != clock::time_point::max();}
+		bool              expired()      const             {return has_deadline() && clock::now() >= _deadline;}
+
+		// Time left before the deadline; zero if it has passed, or duration::max() if there is none.
+		clock::duration remaining() const
+		{
+			if (!has_deadline()) return clock::duration::max();
+			return std::max(_deadline - clock::now(), clock::duration::zero());
+		}
 
 
 		/*
@@ -147,6 +251,19 @@ namespace pleb
 	*/
 	using service_function = std::function<void(request&)>;
 
+	/*
+		Batch services may be implemented as a function taking a span of requests.
+			See issue_batch.
+	*/
+	using batch_service_function = std::function<void(std::span<request>)>;
+
+
+	namespace detail
+	{
+		// Counts changes to the set of services; cached relay routes are discarded when it changes.
+		inline std::atomic<size_t> &service_generation() noexcept    {static std::atomic<size_t> generation = 0; return generation;}
+	}
+
 
 	/*
 		Class for a registered service function which can fulfill requests.
@@ -159,7 +276,21 @@ namespace pleb
 
 	private:
 		template<class P> friend class topic_;
-		const service_function func;
+		friend class resource_data;
+		const service_function       func;
+		const batch_service_function batch_func;
+
+		mutable std::atomic<size_t> _outstanding = 0;
+
+		// The balancing policy of the service group this instance belongs to, if any.
+		std::atomic<const std::atomic<balancing>*> _group_balancing = nullptr;
+
+		const std::shared_ptr<detail::flight_table>   _flights;
+		const std::shared_ptr<detail::response_cache> _cache;
+
+		std::atomic<detail::admission*> _admission = nullptr;
+
+		const bool _relay = false;
 
 
 	public:
@@ -169,7 +300,252 @@ namespace pleb
 			service_function &&_func,
 			service_config     flags = {})
 			:
-			receiver(flags), topic(_topic), func(std::move(_func)) {}
+			receiver(flags), topic(_topic), func(std::move(_func)),
+			_flights(_make_flights(flags)), _cache(_make_cache(flags)) {}
+
+		// A batch service handles single requests as batches of one.
+		service(
+			const pleb::topic      &_topic,
+			batch_service_function &&_func,
+			service_config           flags = {})
+			:
+			receiver(flags), topic(_topic),
+			func([this](pleb::request &r) {batch_func(std::span<pleb::request>(&r, 1));}),
+			batch_func(std::move(_func)),
+			_flights(_make_flights(flags)), _cache(_make_cache(flags)) {}
+
+		~service()
+		{
+			detail::service_generation().fetch_add(1, std::memory_order_release);
+			delete _admission.load(std::memory_order_acquire);
+		}
+
+		// Check whether this service accepts requests in batches.
+		bool is_batch() const noexcept    {return bool(batch_func);}
+
+		// Check whether this service is a service_relay.
+		bool is_relay() const noexcept    {return _relay;}
+
+		/*
+			Call the service function on this thread.
+				Thrown statuses become responses.  If the service neither
+				responds nor claims the client, it responds NoContent.
+				Expired requests are answered GatewayTimeout, and cancelled
+				safe requests are dropped, without calling the service.
+		*/
+		void handle(pleb::request &msg) const
+		{
+			if (msg.expired()) {msg.respond(statuses::GatewayTimeout); return;}
+
+			// Nobody awaits a cancelled request, and safe methods have no other effect.
+			if (msg.method().isSafe() && msg.is_cancelled()) return;
+
+			_call(func, msg);
+		}
+
+		/*
+			Call the service on this thread with a batch of requests.
+				Services which don't accept batches are called once per request.
+				A status thrown by a batch service answers each unanswered request.
+		*/
+		void handle(std::span<pleb::request> batch) const
+		{
+			if (!batch_func) {for (auto &msg : batch) handle(msg); return;}
+
+			auto respond_all = [batch](status s) {for (auto &msg : batch) if (!(msg.features & flags::did_respond)) msg.respond(s);};
+
+			try                            {batch_func(batch);}
+			catch (status s)               {respond_all(s);}
+			catch (statuses s)             {respond_all(s);}
+			catch (status_exception &e)    {respond_all(e.status);}
+
+			respond_all(statuses::NoContent);
+		}
+
+		/*
+			For coalescing services, let a request join an identical request in flight.
+				Returns true if it joined; its client will receive that request's response.
+				Otherwise the request leads a new flight and should be handled normally.
+		*/
+		bool join_flight(pleb::request &msg) const
+		{
+			if (!_flights || (msg.requirements & flags::immediate) || !msg.method().isSafe() || msg.value().has_value()) return false;
+
+			client_ptr client = msg.claim_client();
+			if (!client) return false;
+
+			auto path = msg.topic.path();
+			std::string key;
+			key.reserve(path.size() + 3);
+			key.append(std::to_string(msg.code)).push_back(' ');
+			key.append(path);
+
+			if (client_ptr lead = _flights->join(std::move(key), std::move(client)))
+			{
+				msg.exchange_client(std::move(lead));
+				return false;
+			}
+			msg.features |= flags::did_respond;
+			return true;
+		}
+
+		/*
+			For caching services, answer a GET or HEAD from the cache.
+				Returns true if answered; otherwise the request should be handled normally.
+		*/
+		bool answer_from_cache(pleb::request &msg) const
+		{
+			if (!_cache || !detail::response_cache::caches(msg.method()) || msg.value().has_value()) return false;
+
+			auto cached = _cache->find(msg.method(), msg.topic.path());
+			if (!cached) return false;
+
+			msg.features |= flags::did_respond;
+			if (client_ptr client = msg.exchange_client(nullptr)) client->deliver(*cached);
+			return true;
+		}
+
+		/*
+			For caching services, prepare a request which missed the cache.
+				Responses to cacheable requests will be stored in the cache.
+				Requests with mutating methods invalidate the topic's cached
+				responses now, and again when they are answered or released.
+				Immediate requests, whose clients may not be claimed, are not
+				wrapped, lest the wrapper be claimed in their place.
+		*/
+		void prepare_cache(pleb::request &msg) const
+		{
+			if (!_cache) return;
+
+			auto m = msg.method();
+			if (!detail::response_cache::caches(m) && !m.isSafe()) _cache->invalidate(msg.topic.path());
+
+			if (msg.requirements & flags::immediate) return;
+			client_ptr client = msg.exchange_client(nullptr);
+			if (client && !client.use_count()) {msg.exchange_client(std::move(client)); return;}
+
+			if (detail::response_cache::caches(m))
+			{
+				if (client && !msg.value().has_value())
+					client = std::make_shared<detail::cache_fill_client>(_cache, m, std::move(client));
+			}
+			else if (!m.isSafe())
+				client = std::make_shared<detail::cache_invalidate_client>(_cache, std::string(msg.topic.path()), std::move(client));
+			msg.exchange_client(std::move(client));
+		}
+
+		/*
+			Discard cached responses for a topic and the topics beneath it.
+				PLEB does this when an event is published to a caching service's topic.
+		*/
+		void invalidate_cache(std::string_view path) const    {if (_cache) _cache->invalidate(path);}
+
+		/*
+			Admission control.  Limit the requests this service handles at once,
+				and the requests which may wait for a turn on the default executor.
+				Beyond both limits, requests go to the overflow handler if given,
+				or are answered ServiceUnavailable, without calling the service.
+				Limits may be changed at any time.  Batches are not limited.
+		*/
+		void set_limits(admission_limits limits, service_function overflow = {})
+		{
+			auto *adm = _admission.load(std::memory_order_acquire);
+			if (!adm)
+			{
+				auto created = std::make_unique<detail::admission>(limits);
+				if (_admission.compare_exchange_strong(adm, created.get(), std::memory_order_acq_rel)) adm = created.release();
+			}
+			adm->concurrency.store(limits.concurrency, std::memory_order_relaxed);
+			adm->queue.store(limits.queue, std::memory_order_relaxed);
+			adm->overflow.store(overflow ? std::make_shared<const service_function>(std::move(overflow)) : nullptr);
+		}
+
+		// Admission state, if limits have been set.
+		detail::admission *admission_control() const noexcept    {return _admission.load(std::memory_order_acquire);}
+
+		// Current load.  Without limits, every outstanding request counts as running.
+		service_load load() const noexcept
+		{
+			auto *adm = admission_control();
+			if (!adm) return {outstanding(), 0, 0, {}};
+			return {
+				adm->running.load(std::memory_order_relaxed), adm->queued.load(std::memory_order_relaxed),
+				adm->rejected.load(std::memory_order_relaxed),
+				{adm->concurrency.load(std::memory_order_relaxed), adm->queue.load(std::memory_order_relaxed)}};
+		}
+
+		// Turn away a request beyond the limits.
+		void reject(pleb::request &msg) const
+		{
+			auto *adm = admission_control();
+			if (adm) adm->rejected.fetch_add(1, std::memory_order_relaxed);
+
+			if (auto overflow = adm ? adm->overflow.load() : nullptr) _call(*overflow, msg);
+			else msg.respond(statuses::ServiceUnavailable);
+		}
+
+		/*
+			Number of requests this service is handling, or has queued if pooled.
+				Used to balance load among the instances of a service group.
+				Where that uses least_outstanding, requests are counted until
+				they are answered or released, even if claimed to answer later.
+		*/
+		size_t outstanding() const noexcept    {return _outstanding.load(std::memory_order_relaxed);}
+
+		// Whether requests are counted until answered; see outstanding().
+		bool counts_until_answered() const noexcept
+		{
+			auto *policy = _group_balancing.load(std::memory_order_acquire);
+			return policy && policy->load(std::memory_order_relaxed) == balancing::least_outstanding;
+		}
+
+
+	private:
+		static void _call(const service_function &function, pleb::request &msg)
+		{
+			try                            {function(msg);}
+			catch (status s)               {msg.respond(s);}
+			catch (statuses s)             {msg.respond(s);}
+			catch (status_exception &e)    {msg.respond(e.status);}
+
+			// Default response if service did not respond or move message.
+			if (!(msg.features & flags::did_respond)) msg.respond(statuses::NoContent);
+		}
+
+		static std::shared_ptr<detail::flight_table> _make_flights(const service_config &config)
+		{
+			return (config.handling & flags::coalescing) ? std::make_shared<detail::flight_table>() : nullptr;
+		}
+		static std::shared_ptr<detail::response_cache> _make_cache(const service_config &config)
+		{
+			return (config.handling & flags::caching) ? std::make_shared<detail::response_cache>() : nullptr;
+		}
+
+
+	protected:
+		// Used by service_relay.
+		service(
+			const pleb::topic &_topic,
+			service_function &&_func,
+			service_config     flags,
+			bool               relay)
+			:
+			receiver(flags), topic(_topic), func(std::move(_func)), _relay(relay) {}
+
+
+	public:
+		// Counts requests as outstanding for its lifetime.
+		class occupancy
+		{
+		public:
+			explicit occupancy(const service &s, size_t n = 1) noexcept    : _s(&s), _n(n) {_s->_outstanding.fetch_add(_n, std::memory_order_relaxed);}
+			occupancy(occupancy &&o) noexcept                              : _s(o._s), _n(o._n) {o._s = nullptr;}
+			~occupancy() noexcept                                          {if (_s) _s->_outstanding.fetch_sub(_n, std::memory_order_relaxed);}
+
+		private:
+			const service *_s;
+			size_t         _n;
+		};
 	};
 
 
@@ -223,6 +599,14 @@ namespace pleb
 		template<typename Response>
 		operator std::future<Response>()    {return this->async<Response>();}
 
+		/*
+			2b: auto_request may likewise be converted into a pleb::future.
+
+			eg:  pleb::future<response> result = pleb::GET("/resource/1");
+		*/
+		template<typename Response>
+		operator pleb::future<Response>()   {return this->send<Response>();}
+
 		/*
 			3: a request may be explicitly converted to some other type.
 				This results in a call to await<T>, which may block.
@@ -238,7 +622,7 @@ namespace pleb
 		operator response()    {return this->await<response>();}
 
 		/*
-			4: messages may be sent by calling push(), async<T> or await<T> on this object.
+			4: messages may be sent by calling push(), async<T>, send<T> or await<T> on this object.
 		*/
 	};
 
@@ -261,13 +645,61 @@ namespace pleb
 
 
 	/*
-		A request relay is a special service that forwards messages.
-			It has no additional functionality at the moment.
+		A request relay is a special service that forwards requests to another topic.
+			PLEB follows chains of relays to the service at the end, which receives
+			requests directly; the route is cached until services are added or removed.
+			Requests are retargeted to the last relay's target topic, once.
+			The relay's own handling flags are not used.
 	*/
 	class service_relay : public service
 	{
-	protected:
-		using service::service;
+	public:
+		const pleb::topic target;
+
+		// Longest chain of relays followed before a request is answered LoopDetected.
+		static constexpr size_t max_hops = 16;
+
+		// A resolved chain of relays.
+		struct route
+		{
+			service_ptr service;          // Null if the chain leads nowhere.
+			pleb::topic destination;      // Target of the last relay followed.
+			bool        looped  = false;  // Whether the chain exceeded max_hops.
+		};
+
+
+	public:
+		// Note this class will normally only be created by topic::forward_requests().
+		service_relay(
+			const pleb::topic &_topic,
+			pleb::topic        _target,
+			service_config     flags = {})
+			:
+			service(_topic, [this](pleb::request &r) {forward(r);}, flags, true),
+			target(std::move(_target)) {}
+
+		/*
+			Find the service at the end of this relay's chain.
+				Routes which end at a single service are cached.
+		*/
+		route resolve(flags::filtering filtering) const;
+
+		/*
+			Deliver a request to the service at the end of this relay's chain.
+				Throws service_not_found if the chain leads nowhere.
+		*/
+		void forward(pleb::request &msg) const;
+
+
+	private:
+		struct _cached_route
+		{
+			std::weak_ptr<service> endpoint;
+			pleb::topic            destination;
+			flags::filtering       filtering;
+			size_t                 generation;
+		};
+		mutable std::atomic<std::shared_ptr<const _cached_route>> _route;
 	};
 
 
@@ -282,11 +714,13 @@ namespace pleb
 		if (!(flags.filtering & pleb::flags::recursive) && is_ancestor_of(service_topic))
 			throw std::logic_error("Forwarding requests to a child topic might cause a stack overflow.");
 
-		return std::static_pointer_cast<service_relay>(
-			serve([service_topic = std::move(service_topic)](pleb::request &request)
-		{
-			request.topic = service_topic;
-			service_topic.issue(request);
-		}, flags));
+		auto &node = this->_realize();
+		if constexpr (type_can_be_null) null_topic_error::check(node, "can't serve", "(null topic)");
+		if (node->has_group_services()) return nullptr;
+
+		auto relay = std::make_shared<service_relay>(topic(node), std::move(service_topic), flags);
+		if (!node->try_insert_service(relay)) return nullptr;
+		_announce(relay);
+		return relay;
 	}
 }
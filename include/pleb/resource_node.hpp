@@ -1,6 +1,9 @@
 #pragma once
 
 #include <deque>
+#include <mutex>
+#include <thread>
+#include <functional>
 
 #include "coop/pool.hpp"
 #include "coop/trie.hpp"
@@ -9,6 +12,7 @@
 
 
 namespace coop {template<class T> class trie_;}
+namespace pleb {class retention; class event_history;}
 
 /*
 	Base class for resource trie.
@@ -30,12 +34,25 @@ namespace pleb
 
 
 	public:
-		// Try to emplace a service.  May fail if service already exists.
+		// Try to emplace a service.  May fail if a service or service group already exists.
+		template<typename Function>
 		[[nodiscard]] std::shared_ptr<service>
 			try_emplace_service(
 				const resource_node_ptr &p,
-				service_function       &&f,
-				service_config           flags)    {return _service.try_emplace(p, std::move(f), flags);}
+				Function               &&f,
+				service_config           flags)
+		{
+			std::lock_guard<std::mutex> lock(_serving);
+			if (has_group_services()) return nullptr;
+			return _changed(_service.try_emplace(p, std::forward<Function>(f), flags));
+		}
+
+		// Try to insert a service of a derived class, such as a relay.  May fail as try_emplace_service.
+		bool try_insert_service(const std::shared_ptr<service> &s) noexcept
+		{
+			std::lock_guard<std::mutex> lock(_serving);
+			return !has_group_services() && _changed(_service.try_insert(s));
+		}
 
 		// Access the service like a weak_ptr
 		std::shared_ptr<service> service_lock() const noexcept    {return _service.lock();}
@@ -43,27 +60,260 @@ namespace pleb
 		bool service_expired()                  const noexcept    {return _service.expired();}
 
 
+		// Add an instance to the service group.  Fails if a single service exists.
+		[[nodiscard]] std::shared_ptr<service>
+			emplace_group_service(
+				const resource_node_ptr &p,
+				service_function       &&f,
+				service_config           flags,
+				balancing                policy)
+		{
+			std::lock_guard<std::mutex> lock(_serving);
+			if (!_service.expired()) return nullptr;
+			_balancing.store(policy, std::memory_order_relaxed);
+			_grouped.store(true, std::memory_order_release);
+			auto ptr = _group.emplace(p, std::move(f), flags);
+			if (ptr) ptr->_group_balancing.store(&_balancing, std::memory_order_release);
+			return _changed(std::move(ptr));
+		}
+
+		// Check whether the service group has any instances.
+		bool has_group_services() const noexcept    {return _grouped.load(std::memory_order_acquire) && _group.begin() != _group.end();}
+
+		// Choose an instance from the service group, if any accepts the filtering flags.
+		std::shared_ptr<service> group_lock(flags::filtering filtering) const
+		{
+			if (!_grouped.load(std::memory_order_acquire)) return nullptr;
+
+			auto accepts = [filtering](const service &s) {return s.accepts(filtering);};
+			switch (_balancing.load(std::memory_order_relaxed))
+			{
+			case balancing::least_outstanding:
+				{
+					std::shared_ptr<service> best;
+					for (auto i = _group.begin(), e = _group.end(); i != e; ++i)
+						if (i->accepts(filtering) && (!best || i->outstanding() < best->outstanding())) best = i;
+					return best;
+				}
+			case balancing::affinity:
+				return _group.lock_from(std::hash<std::thread::id>()(std::this_thread::get_id()), accepts);
+
+			case balancing::round_robin:
+			default:
+				{
+					// The cursor moves past each chosen instance; races only cost a little balance.
+					size_t found = 0;
+					auto ptr = _group.lock_from(_cursor.load(std::memory_order_relaxed), accepts, &found);
+					if (ptr) _cursor.store(found + 1, std::memory_order_relaxed);
+					return ptr;
+				}
+			}
+		}
+
+
 		// Emplace a subscriber.
+		template<typename Function>
 		[[nodiscard]] std::shared_ptr<subscription>
 			emplace_subscriber(
 				const resource_node_ptr &p,
-				subscriber_function    &&f,
-				subscription_config      flags)    {return _subs.emplace(p, std::move(f), flags);}
+				Function               &&f,
+				subscription_config      flags)    {return _subs.emplace(p, std::forward<Function>(f), flags);}
+
+		// Insert a subscriber of a derived class, such as a relay.
+		void insert_subscriber(const std::shared_ptr<subscription> &s)    {_subs.insert(s);}
 
 		// Iterate over subscribers.
 		const subscriber_list &subscriptions() const    {return _subs;}
 
+		/*
+			Whether any subscriber or service may be at this resource or above it.
+				Each is cached, so that publishing or requesting where nothing listens
+				is cheap.  A cached false holds until a receiver appears at this
+				resource or above, which advances the epochs of its subtree only.
+				A cached true holds until a receiver of that kind is lost anywhere.
+		*/
+		static bool observed(const resource_node_ptr &node) noexcept;
+		static bool served  (const resource_node_ptr &node) noexcept;
+
+		// Whether a service with flags::caching may be at this resource or above it; cached likewise.
+		static bool caching (const resource_node_ptr &node) noexcept;
+
+		// Whether a retention or history may be set at this resource or above it; cached likewise.
+		static bool noted   (const resource_node_ptr &node) noexcept;
+
+		// Deliver events in parallel once this many subscriptions are live here, or never if zero.  See fan_out.hpp.
+		void   set_fan_out(size_t min_subscribers) noexcept    {_fan_out.store(min_subscribers, std::memory_order_relaxed);}
+		size_t fan_out() const noexcept                        {return _fan_out.load(std::memory_order_relaxed);}
+
+		// Number of live subscriptions to this resource.
+		size_t subscription_count() const noexcept    {return _subscribers.load(std::memory_order_relaxed);}
+
+
+		// The last event published here, if it is retained.  See retention.hpp.
+		std::shared_ptr<const event> retained() const noexcept    {return _retained.load(std::memory_order_acquire);}
+
+		// Retain events in this subtree, replacing any retention set here.
+		void set_retention(const std::shared_ptr<retention> &r) noexcept    {_retention.store(r); _retains.store(true); _gained();}
+
+		// Record events in this subtree, replacing any history set here.  See history.hpp.
+		void set_history(const std::shared_ptr<event_history> &h) noexcept    {_history.store(h); _records.store(true); _gained();}
+
 
 	private:
 		// This class is intended for use only as a base class of topic.
 		template<class P> friend class topic_;
 		friend class coop::trie_<resource_data>;
+		friend class retention;
+		friend class event_history;
+		friend class subscription;
 		resource_data() {}
 
+		// Note a change to the set of services.
+		template<typename T>
+		T _changed(T result) noexcept
+		{
+			if (result)
+			{
+				detail::service_generation().fetch_add(1, std::memory_order_release);
+				_gained();
+			}
+			return result;
+		}
+
+		// Advance the epochs of this resource and its descendants, as a receiver has appeared here.
+		void _gained() noexcept;
+
+		// Counts retentions and histories released; cached noted() flags which are true are recomputed when it changes.
+		static std::atomic<size_t> &_releases() noexcept    {static std::atomic<size_t> releases = 0; return releases;}
+
+		/*
+			Note the release of the retention or history set here, clearing its flag
+				unless another has been set meanwhile.  Sequentially consistent with
+				set_retention() and set_history(), so a new one is never unflagged.
+		*/
+		template<class Store>
+		static void _released(const std::atomic<std::weak_ptr<Store>> &store, std::atomic<bool> &flag) noexcept
+		{
+			flag.store(false);
+			if (!store.load().expired()) flag.store(true);
+			_releases().fetch_add(1, std::memory_order_release);
+		}
+
+		// Count a retained event here, or its removal, in this resource's and its ancestors' subtrees.
+		void _count_retained(bool gained) noexcept;
+
+		/*
+			Get a flag cached at a resource, or compute and cache it.
+				A false flag is kept for the resource's epoch and a true one for the given generation.
+		*/
+		template<typename Compute>
+		static bool _cached(std::atomic<size_t> &cache, const resource_data &node, size_t generation, const Compute &compute) noexcept
+		{
+			size_t epoch = node._epoch.load(std::memory_order_acquire);
+			size_t entry = cache.load(std::memory_order_relaxed);
+			if ((entry >> 1) == ((entry & 1) ? generation : epoch) + 1) return entry & 1;
+
+			bool flag = compute();
+			cache.store((((flag ? generation : epoch) + 1) << 1) | size_t(flag), std::memory_order_relaxed);
+			return flag;
+		}
+
 
 	private:
-		subscriber_list _subs;
-		service_slot    _service;
+		subscriber_list     _subs;
+		service_slot        _service;
+		std::mutex          _serving; // Held while adding a service or group instance, which exclude each other.
+		std::atomic<size_t> _fan_out = 0;
+
+		// Subscriptions to this resource, and the cached flags of observed(), served(), caching() and noted().
+		std::atomic<size_t>         _subscribers = 0;
+		std::atomic<size_t>         _epoch       = 0; // Advanced when a receiver appears here or above.
+		mutable std::atomic<size_t> _observed    = 0, _served = 0, _caching = 0, _noted = 0;
+
+		// Service group, used in place of a single service.
+		coop::unmanaged::pool<service> _group;
+		std::atomic<bool>              _grouped   = false;
+		std::atomic<balancing>         _balancing = balancing::round_robin;
+		mutable std::atomic<size_t>    _cursor    = 0;
+
+		// Retained event, and the retention set at this subtree, if any.  The flag spares publishers a load.
+		std::atomic<std::shared_ptr<const event>> _retained;
+		std::atomic<std::weak_ptr<retention>>     _retention;
+		std::atomic<bool>                         _retains   = false;
+		std::atomic<bool>                         _retaining = false; // Counted by a retention.
+		std::atomic<size_t>                       _retained_below = 0; // Resources counted in this subtree.
+
+		// The history set at this subtree, if any.  The flag spares publishers a load.
+		std::atomic<std::weak_ptr<event_history>> _history;
+		std::atomic<bool>                         _records  = false;
 	};
+
+
+	inline bool resource_data::observed(const resource_node_ptr &node) noexcept
+	{
+		return _cached(node->_observed, *node, detail::subscription_generation().load(std::memory_order_acquire), [&node]
+		{
+			// Ancestors are kept alive by the resource.
+			for (auto *n = node.get(); n; n = n->parent().get())
+				if (n->_subscribers.load(std::memory_order_relaxed)) return true;
+			return false;
+		});
+	}
+
+	inline bool resource_data::served(const resource_node_ptr &node) noexcept
+	{
+		return _cached(node->_served, *node, detail::service_generation().load(std::memory_order_acquire), [&node]
+		{
+			for (auto *n = node.get(); n; n = n->parent().get())
+				if (!n->service_expired() || n->has_group_services()) return true;
+			return false;
+		});
+	}
+
+	inline bool resource_data::caching(const resource_node_ptr &node) noexcept
+	{
+		return _cached(node->_caching, *node, detail::service_generation().load(std::memory_order_acquire), [&node]
+		{
+			auto caches = [](const service &s) {return bool(s.handling & flags::caching);};
+			for (auto *n = node.get(); n; n = n->parent().get())
+			{
+				if (auto svc = n->service_lock(); svc && caches(*svc)) return true;
+				if (n->_grouped.load(std::memory_order_acquire))
+					for (auto i = n->_group.begin(), e = n->_group.end(); i != e; ++i) if (caches(*i)) return true;
+			}
+			return false;
+		});
+	}
+
+	inline bool resource_data::noted(const resource_node_ptr &node) noexcept
+	{
+		return _cached(node->_noted, *node, _releases().load(std::memory_order_acquire), [&node]
+		{
+			for (auto *n = node.get(); n; n = n->parent().get())
+				if (n->_retains.load(std::memory_order_relaxed) || n->_records.load(std::memory_order_relaxed)) return true;
+			return false;
+		});
+	}
+
+	inline void resource_data::_count_retained(bool gained) noexcept
+	{
+		for (auto *n = static_cast<resource_node*>(this); n; n = n->parent().get())
+		{
+			if (gained) n->_retained_below.fetch_add(1, std::memory_order_relaxed);
+			else        n->_retained_below.fetch_sub(1, std::memory_order_relaxed);
+		}
+	}
+
+	inline void resource_data::_gained() noexcept
+	{
+		_epoch.fetch_add(1, std::memory_order_acq_rel);
+
+		// Links are not descendants.
+		auto &self = static_cast<resource_node&>(*this);
+		self.visit_children([&self](const std::string&, resource_node_ptr child)
+		{
+			if (child->parent().get() == &self) child->_gained();
+		});
+	}
 }
 
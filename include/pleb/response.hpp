@@ -1,10 +1,15 @@
 #pragma once
 
 
+#include <cstddef>
+#include <cstdint>
 #include <future>
 #include <exception>
+#include <optional>
+#include <atomic>
 
 #include "message.hpp"
+#include "executor.hpp"
 #include "status.hpp"
 
 /*
@@ -79,6 +84,12 @@ namespace pleb
 			:
 			receiver(flags), func(std::move(_func)) {}
 
+		virtual ~client()
+		{
+			auto list = _on_cancel.load(std::memory_order_acquire);
+			if (list != _cancelled_marker()) while (list) {auto next = list->next; delete list; list = next;}
+		}
+
 
 		/*
 			Reply to this client.
@@ -92,6 +103,61 @@ namespace pleb
 				func(re);
 			}
 		}
+
+		/*
+			Pass a prepared response to this client.
+		*/
+		void deliver(response &re) const    {if (func) func(re);}
+
+
+		/*
+			Cancellation.  A requester cancels its client when it no longer wants
+				a response, eg by dropping a pleb::future or cancelling a task.
+				Services holding the client may check is_cancelled() or register
+				callbacks with on_cancel() to stop work early.  Responding to a
+				cancelled client is harmless.
+
+			Callbacks run once, on the cancelling thread, or immediately if the
+				client is already cancelled.  Clients which wrap another client
+				forward these queries to it.
+		*/
+		virtual bool is_cancelled() const noexcept    {return _on_cancel.load(std::memory_order_acquire) == _cancelled_marker();}
+
+		virtual void on_cancel(std::function<void()> callback)
+		{
+			auto node = new cancel_callback{std::move(callback), _on_cancel.load(std::memory_order_acquire)};
+			while (node->next != _cancelled_marker())
+				if (_on_cancel.compare_exchange_weak(node->next, node, std::memory_order_acq_rel)) return;
+
+			std::unique_ptr<cancel_callback> cancelled(node);
+			cancelled->callback();
+		}
+
+		void cancel() noexcept
+		{
+			auto list = _on_cancel.exchange(_cancelled_marker(), std::memory_order_acq_rel);
+			if (list == _cancelled_marker()) return;
+			while (list)
+			{
+				std::unique_ptr<cancel_callback> node(list);
+				list = node->next;
+				try            {node->callback();}
+				catch (...)    {}
+			}
+		}
+
+
+	private:
+		struct cancel_callback
+		{
+			std::function<void()> callback;
+			cancel_callback      *next;
+		};
+
+		// A lock-free stack of callbacks, replaced by a marker upon cancellation.
+		std::atomic<cancel_callback*> _on_cancel = nullptr;
+
+		static cancel_callback *_cancelled_marker() noexcept    {static cancel_callback marker; return &marker;}
 	};
 
 
@@ -150,6 +216,152 @@ namespace pleb
 
 
 
+	namespace detail
+	{
+		/*
+			An allocator which places a single shared_ptr control block
+				in a buffer belonging to Owner, rather than on the heap.
+				Owner is notified when the control block is deallocated,
+				which is the last time the shared_ptr machinery touches it.
+		*/
+		template<typename T, class Owner>
+		struct control_block_allocator
+		{
+			using value_type = T;
+
+			Owner *owner;
+
+			control_block_allocator(Owner *o) noexcept                                          : owner(o) {}
+			template<class U> control_block_allocator(const control_block_allocator<U,Owner> &o) noexcept    : owner(o.owner) {}
+
+			T *allocate(size_t n)
+			{
+				if (n*sizeof(T) <= sizeof(owner->_cb_buffer)) return reinterpret_cast<T*>(owner->_cb_buffer);
+				return std::allocator<T>().allocate(n); // Unusually large control block
+			}
+			void deallocate(T *p, size_t n) noexcept
+			{
+				Owner *o = owner;
+				if ((void*) p != (void*) o->_cb_buffer) std::allocator<T>().deallocate(p, n);
+				o->_cb_released();
+			}
+
+			template<class U> bool operator==(const control_block_allocator<U,Owner> &o) const noexcept    {return owner == o.owner;}
+			template<class U> bool operator!=(const control_block_allocator<U,Owner> &o) const noexcept    {return owner != o.owner;}
+		};
+
+		/*
+			Storage for the first response delivered to a client, as T.
+				Base class for clients which hold their response in place.
+		*/
+		template<typename T>
+		class response_slot
+		{
+		public:
+			// Check whether a response has been delivered.
+			bool has_response() const noexcept    {return _value || _error;}
+
+			/*
+				Take the response, as std::future::get would.
+					Throws std::future_error if no response was delivered.
+			*/
+			T take()
+			{
+				if (_error) std::rethrow_exception(_error);
+				if (!_value) throw std::future_error(std::future_errc::broken_promise);
+				return std::move(*_value);
+			}
+
+
+		protected:
+			std::optional<T>   _value;
+			std::exception_ptr _error;
+
+			void _receive(response &r)
+			{
+				if (has_response()) return; // Only the first response counts
+				if constexpr (std::is_same_v<T, response>) _value.emplace(std::move(r));
+				else try {_value.emplace(r.move_as<T>());} catch (std_any::bad_any_cast) {_error = std::current_exception();}
+			}
+		};
+
+		/*
+			A client which lives on the caller's stack, used by request::await.
+				Sharing it places the shared_ptr control block in an internal
+				buffer, so issuing a request this way performs no allocation.
+				If the service claims the client to respond later, get() waits
+				until every reference to the client has been released.
+		*/
+		template<typename T>
+		class stack_client : public client, public response_slot<T>
+		{
+		public:
+			stack_client()
+				:
+				client([this](response &r) {this->_receive(r);}, flags::realtime) {}
+
+			~stack_client()    {wait();}
+
+			/*
+				Produce a reference to this client.  Only one may exist at a time.
+					share_unowned() omits reference counting entirely, and may only be
+					used when the service is known to respond before returning.
+			*/
+			client_ptr share()
+			{
+				_shared.store(true, std::memory_order_relaxed);
+				return client_ptr(static_cast<client*>(this), [](client*) noexcept {},
+					control_block_allocator<char, stack_client>(this));
+			}
+			client_ptr share_unowned() noexcept    {return client_ptr(std::shared_ptr<void>(), static_cast<client*>(this));}
+
+			// Wait until no references to this client remain.  Workers run other jobs meanwhile.
+			void wait() const noexcept
+			{
+				if (executor::help_until([this] {return !_shared.load(std::memory_order_acquire);})) return;
+
+				auto &bell = _bell(this);
+				while (true)
+				{
+					uint32_t ring = bell.load(std::memory_order_acquire);
+					if (!_shared.load(std::memory_order_acquire)) return;
+					bell.wait(ring, std::memory_order_acquire);
+				}
+			}
+
+			// Wait for the response and return it.
+			T get()    {wait(); return this->take();}
+
+
+		private:
+			template<typename, class> friend struct control_block_allocator;
+
+			std::atomic<bool> _shared = false;
+
+			alignas(std::max_align_t) unsigned char _cb_buffer[8*sizeof(void*)];
+
+			/*
+				The waiter may destroy this client as soon as _shared is cleared,
+					so the releaser wakes it through a bell which outlives the client.
+			*/
+			static std::atomic<uint32_t> &_bell(const void *client) noexcept
+			{
+				static std::atomic<uint32_t> bells[64] = {};
+				return bells[(reinterpret_cast<uintptr_t>(client) / alignof(std::max_align_t)) % 64];
+			}
+
+			void _cb_released() noexcept
+			{
+				auto &bell = _bell(this);
+				_shared.store(false, std::memory_order_release);
+				bell.fetch_add(1, std::memory_order_release);
+				bell.notify_all();
+			}
+		};
+	}
+
+
+
 	template<typename T>
 	client_ref::client_ref(std::future<T> *f)
 		: client_ptr(f ? std::make_shared<client_promise<T>>(f) : nullptr) {}
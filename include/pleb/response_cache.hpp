@@ -0,0 +1,194 @@
+#pragma once
+
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <map>
+#include <list>
+#include <optional>
+#include <shared_mutex>
+
+#include "response.hpp"
+#include "method.hpp"
+
+/*
+	Response caching for services with flags::caching.
+
+	Successful responses to GET and HEAD are kept per topic and served again
+		without calling the service.  A topic's responses are invalidated when
+		an event is published there, or when a request with a mutating method
+		(PUT, PATCH, DELETE, POST...) passes through the service.
+
+	The cache carries a version, advanced by every invalidation.  A response
+		is only stored if no invalidation happened while it was being produced.
+
+	Entries are ordered by topic, so a topic's subtree is found by one search.
+		The cache holds at most max_topics topics; storing a new one beyond that
+		evicts the least recently stored.
+*/
+
+
+namespace pleb
+{
+	namespace detail
+	{
+		/*
+			Cached responses for one service, by topic.
+		*/
+		class response_cache
+		{
+		public:
+			static constexpr size_t max_topics = 1024;
+
+
+		public:
+			response_cache() noexcept     {_live().fetch_add(1, std::memory_order_relaxed);}
+			~response_cache() noexcept    {_live().fetch_sub(1, std::memory_order_relaxed);}
+
+			// Check whether any caches exist, so publishers can skip invalidation.
+			static bool any_live() noexcept    {return _live().load(std::memory_order_relaxed);}
+
+			// Check whether responses to a method may be cached: cacheable and safe, so not POST.
+			static bool caches(pleb::method m) noexcept    {return m.isCacheable() && m.isSafe();}
+
+			// The current version, advanced by every invalidation.
+			uint64_t version() const noexcept    {return _version.load(std::memory_order_acquire);}
+
+			// Number of topics with cached responses.
+			size_t size() const    {std::shared_lock<std::shared_mutex> lock(_mutex); return _entries.size();}
+
+
+			/*
+				Look up a cached response, returning a copy of it.
+			*/
+			std::optional<response> find(pleb::method m, std::string_view path) const
+			{
+				std::shared_lock<std::shared_mutex> lock(_mutex);
+
+				auto i = _entries.find(path);
+				if (i == _entries.end() || !i->second.responses[_slot(m)]) return std::nullopt;
+				return *i->second.responses[_slot(m)];
+			}
+
+			/*
+				Store a response produced while the cache was at the given version.
+					Only successful responses are stored.
+			*/
+			void store(pleb::method m, const response &r, uint64_t version)
+			{
+				if (!r.status().isSuccess()) return;
+
+				std::unique_lock<std::shared_mutex> lock(_mutex);
+				if (version != _version.load(std::memory_order_relaxed)) return;
+
+				auto path = r.topic.path();
+				auto i = _entries.find(path);
+				if (i == _entries.end())
+				{
+					if (_entries.size() >= max_topics) _erase(_entries.find(_stored.front()));
+					i = _entries.emplace(std::string(path), entry{}).first;
+					i->second.stored = _stored.insert(_stored.end(), i->first);
+				}
+				else _stored.splice(_stored.end(), _stored, i->second.stored);
+				i->second.responses[_slot(m)].emplace(r);
+			}
+
+			/*
+				Discard cached responses for a topic and every topic beneath it.
+			*/
+			void invalidate(std::string_view path)
+			{
+				std::unique_lock<std::shared_mutex> lock(_mutex);
+				_version.fetch_add(1, std::memory_order_release);
+
+				// Topics beginning with the path are contiguous; of those, only the path and its children are beneath it.
+				for (auto i = _entries.lower_bound(path); i != _entries.end();)
+				{
+					std::string_view key = i->first;
+					if (!key.starts_with(path)) break;
+					bool beneath = (key.size() == path.size() || path.empty() || key[path.size()] == '/');
+					if (beneath) i = _erase(i);
+					else         ++i;
+				}
+			}
+
+
+		private:
+			using key_list = std::list<std::string_view>;
+
+			struct entry
+			{
+				std::array<std::optional<response>, 2> responses;
+				key_list::iterator                     stored;     // Position in order of storing.
+			};
+			using entry_map = std::map<std::string, entry, std::less<>>;
+
+			mutable std::shared_mutex _mutex;
+			entry_map                 _entries;
+			key_list                  _stored;      // Topics, least recently stored first.
+			std::atomic<uint64_t>     _version = 0;
+
+			entry_map::iterator _erase(entry_map::iterator i)
+			{
+				_stored.erase(i->second.stored);
+				return _entries.erase(i);
+			}
+
+			static size_t _slot(pleb::method m) noexcept    {return (m == method::HEAD) ? 1 : 0;}
+
+			static std::atomic<size_t> &_live() noexcept    {static std::atomic<size_t> live = 0; return live;}
+		};
+
+
+		/*
+			Client which stores a response in the cache before passing it on.
+		*/
+		class cache_fill_client : public client
+		{
+		public:
+			cache_fill_client(std::shared_ptr<response_cache> cache, pleb::method m, client_ptr next)
+				:
+				client([this](response &r) {_cache->store(_method, r, _version); if (_next) _next->deliver(r);}, flags::realtime),
+				_cache(std::move(cache)), _version(_cache->version()), _method(m), _next(std::move(next)) {}
+
+			bool is_cancelled() const noexcept override           {return _next && _next->is_cancelled();}
+			void on_cancel(std::function<void()> callback) override    {if (_next) _next->on_cancel(std::move(callback));}
+
+
+		private:
+			std::shared_ptr<response_cache> _cache;
+			uint64_t                        _version;
+			pleb::method                    _method;
+			client_ptr                      _next;
+		};
+
+		/*
+			Client for a mutating request, which invalidates the cache again
+				once the request is answered or released.  This discards any
+				response produced while the change was underway.
+		*/
+		class cache_invalidate_client : public client
+		{
+		public:
+			cache_invalidate_client(std::shared_ptr<response_cache> cache, std::string path, client_ptr next)
+				:
+				client([this](response &r) {_invalidate(); if (_next) _next->deliver(r);}, flags::realtime),
+				_cache(std::move(cache)), _path(std::move(path)), _next(std::move(next)) {}
+
+			~cache_invalidate_client()    {_invalidate();}
+
+			bool is_cancelled() const noexcept override           {return _next && _next->is_cancelled();}
+			void on_cancel(std::function<void()> callback) override    {if (_next) _next->on_cancel(std::move(callback));}
+
+
+		private:
+			std::shared_ptr<response_cache> _cache;
+			std::string                     _path;
+			client_ptr                      _next;
+			bool                            _done = false;
+
+			void _invalidate()    {if (!_done) {_done = true; _cache->invalidate(_path);}}
+		};
+	}
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "resource_node.hpp"
+
+/*
+	Retained events; see topic::retain.
+
+	Within a retaining subtree, the last event published to each topic is kept,
+		so a new subscriber receives the current state at once instead of
+		waiting for the next publish or making a request.  Retained events are
+		immutable and held by an atomic pointer on the resource, so reading
+		one is a single load and publishers never wait on readers.
+
+	A retention is bounded by a number of topics.  Once it is full, topics
+		without a retained event are refused, while those retained are still
+		updated.  Announcements and subscriber exceptions are never retained,
+		nor are events whose content may not be copied (flags::no_copying).
+
+	Retained events are forgotten when the retention is released.
+*/
+
+
+namespace pleb
+{
+	/*
+		A subtree whose topics keep their last event.
+	*/
+	class retention
+	{
+	public:
+		const size_t capacity; // Maximum number of retained topics.
+
+
+	public:
+		// Note this class will normally only be created by topic::retain().
+		retention(resource_node_ptr root, size_t max_topics) noexcept
+			:
+			capacity(max_topics), _root(std::move(root)) {_live().fetch_add(1, std::memory_order_relaxed);}
+
+		~retention()    {clear(); _live().fetch_sub(1, std::memory_order_relaxed); resource_data::_released(_root->_retention, _root->_retains);}
+
+		retention(const retention&) = delete;
+		void operator=(const retention&) = delete;
+
+		// Number of topics with a retained event.
+		size_t size()    const noexcept    {return _size.load(std::memory_order_relaxed);}
+
+		// Number of events not retained because the retention was full.
+		size_t refused() const noexcept    {return _refused.load(std::memory_order_relaxed);}
+
+		// Forget all retained events.  Events published meanwhile may be retained anew.
+		void clear();
+
+		// Check whether any retentions exist, so publishers can skip the search.
+		static bool any_live() noexcept    {return _live().load(std::memory_order_relaxed);}
+
+		// Find the nearest retention covering a resource, if any.
+		static std::shared_ptr<retention> find(const resource_node_ptr &node);
+
+		// Retain an event at a resource, if there is room.
+		void store(const resource_node_ptr &node, const event &e);
+
+
+	private:
+		const resource_node_ptr        _root;  // Kept so the subtree stays retaining.
+		std::mutex                     _mutex;
+		std::vector<resource_node_ptr> _nodes; // Resources are kept while their events are retained.
+		std::atomic<size_t>            _size = 0, _refused = 0;
+
+		static std::atomic<size_t> &_live() noexcept    {static std::atomic<size_t> live = 0; return live;}
+	};
+
+
+	inline std::shared_ptr<retention> retention::find(const resource_node_ptr &node)
+	{
+		// Ancestors are kept alive by the resource.
+		for (auto *n = node.get(); n; n = n->parent().get())
+			if (n->_retains.load(std::memory_order_relaxed))
+				if (auto r = n->_retention.load(std::memory_order_acquire).lock()) return r;
+		return nullptr;
+	}
+
+	inline void retention::store(const resource_node_ptr &node, const event &e)
+	{
+		// The first event at a resource takes a place, if one is free.
+		if (!node->_retaining.exchange(true, std::memory_order_acq_rel))
+		{
+			if (_size.fetch_add(1, std::memory_order_relaxed) >= capacity)
+			{
+				_size.fetch_sub(1, std::memory_order_relaxed);
+				_refused.fetch_add(1, std::memory_order_relaxed);
+				node->_retaining.store(false, std::memory_order_release);
+				return;
+			}
+			node->_count_retained(true);
+			std::lock_guard lock(_mutex);
+			_nodes.push_back(node);
+		}
+
+		// A clear may have released the place meanwhile; if so, take the event back.
+		//   Clear releases the place before the event, so one of the two sees the other.
+		auto shared = detail::share_event(e);
+		node->_retained.store(shared, std::memory_order_seq_cst);
+		if (!node->_retaining.load(std::memory_order_seq_cst))
+			node->_retained.compare_exchange_strong(shared, nullptr, std::memory_order_acq_rel);
+	}
+
+	inline void retention::clear()
+	{
+		std::vector<resource_node_ptr> nodes;
+		{
+			std::lock_guard lock(_mutex);
+			nodes.swap(_nodes);
+		}
+		for (auto &node : nodes)
+		{
+			node->_retaining.store(false, std::memory_order_seq_cst);
+			node->_retained.store(nullptr, std::memory_order_seq_cst);
+			node->_count_retained(false);
+		}
+		_size.fetch_sub(nodes.size(), std::memory_order_relaxed);
+	}
+}
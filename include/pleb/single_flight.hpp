@@ -0,0 +1,113 @@
+#pragma once
+
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "response.hpp"
+
+/*
+	Request coalescing ("single flight") for services with flags::coalescing.
+
+	While a safe request is in flight to such a service, identical requests
+		(same method and topic, no value) join it instead of invoking the
+		service again.  The one response is copied to every joined client.
+*/
+
+
+namespace pleb
+{
+	namespace detail
+	{
+		class flight_table;
+
+		/*
+			Client for the leading request of a flight.
+				It passes the response to the leader's own client
+				and a copy to each client which joined the flight.
+		*/
+		class flight_client : public client
+		{
+		public:
+			flight_client(std::shared_ptr<flight_table> table, std::string key, client_ptr leader)
+				:
+				client([this](response &r) {_land(&r);}, flags::realtime),
+				_table(std::move(table)), _key(std::move(key)), _leader(std::move(leader)) {}
+
+			// If released unanswered, joined clients are released unanswered too.
+			~flight_client()    {_land(nullptr);}
+
+
+		private:
+			std::shared_ptr<flight_table> _table;
+			std::string                   _key;
+			client_ptr                    _leader;
+			bool                          _landed = false;
+
+			void _land(response *r);
+		};
+
+
+		/*
+			Flights in progress for one service, by method and topic.
+		*/
+		class flight_table : public std::enable_shared_from_this<flight_table>
+		{
+		public:
+			/*
+				Join the flight in progress for a key, or begin a new one.
+					Returns null after joining, or the client for a new flight's leading request.
+			*/
+			client_ptr join(std::string key, client_ptr client)
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+
+				auto i = _flights.find(key);
+				if (i != _flights.end()) {i->second.joined.push_back(std::move(client)); return nullptr;}
+
+				auto lead = std::make_shared<flight_client>(shared_from_this(), key, std::move(client));
+				_flights.emplace(std::move(key), flight{lead.get(), {}});
+				return lead;
+			}
+
+			// End a flight, returning the clients which joined it.
+			std::vector<client_ptr> land(const std::string &key, const flight_client *lead)
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+
+				auto i = _flights.find(key);
+				if (i == _flights.end() || i->second.lead != lead) return {};
+
+				auto joined = std::move(i->second.joined);
+				_flights.erase(i);
+				return joined;
+			}
+
+
+		private:
+			struct flight
+			{
+				const flight_client    *lead;
+				std::vector<client_ptr> joined;
+			};
+
+			std::mutex                              _mutex;
+			std::unordered_map<std::string, flight> _flights;
+		};
+
+
+		inline void flight_client::_land(response *r)
+		{
+			if (_landed) return;
+			_landed = true;
+
+			auto joined = _table->land(_key, this);
+			if (!r) return;
+
+			for (auto &c : joined) {response copy(*r); c->deliver(copy);}
+			if (_leader) _leader->deliver(*r);
+		}
+	}
+}
@@ -0,0 +1,264 @@
+#pragma once
+
+
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <cstdint>
+#include <algorithm>
+#include <condition_variable>
+
+/*
+	A hierarchical timer wheel, after Varghese & Lauck (1987).
+
+	Timers are intrusive: each is an object derived from timer_wheel::timer,
+		linked into one of the wheel's slots.  Scheduling and cancelling
+		are constant-time, and memory is owned by the timers themselves,
+		so the wheel handles hundreds of thousands of pending timers cheaply.
+
+	The wheel has four levels of 256 slots, with a resolution of one
+		millisecond; the levels span 256ms, 65s, 4.6 hours and 49 days.
+		Timers further out are re-filed when the top level turns over.
+		A single thread, started on first use, fires timers as they expire;
+		it only wakes when a slot with timers comes due or a level turns over.
+*/
+
+
+namespace pleb
+{
+	class timer_wheel
+	{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		static constexpr unsigned   slot_bits = 8, levels = 4;
+		static constexpr uint64_t   slots     = uint64_t(1) << slot_bits;
+		static constexpr auto       resolution = std::chrono::milliseconds(1);
+
+
+	private:
+		struct link
+		{
+			link *prev = nullptr, *next = nullptr;
+
+			bool linked() const noexcept    {return next != nullptr;}
+		};
+
+
+	public:
+		/*
+			Base class for timers.  expire() is called on the wheel's thread.
+				Derived classes must cancel the timer before they are destroyed.
+		*/
+		class timer : private link
+		{
+		public:
+			timer()                        = default;
+			timer(const timer&)            = delete;
+			timer &operator=(const timer&) = delete;
+
+		protected:
+			~timer() = default;
+
+			virtual void expire() = 0;
+
+		private:
+			friend class timer_wheel;
+			uint64_t _tick = 0;
+		};
+
+
+	public:
+		timer_wheel()
+			:
+			_start(clock::now())
+		{
+			for (auto &level : _slots) for (auto &slot : level) _clear(slot);
+			_clear(_due);
+		}
+
+		~timer_wheel()
+		{
+			{
+				std::lock_guard<std::mutex> lock(_mutex);
+				_stop = true;
+			}
+			_wake.notify_all();
+			if (_thread.joinable()) _thread.join();
+		}
+
+
+		/*
+			Schedule a timer to expire at the given time, or reschedule it.
+				Timers never expire early, and expire at most about one
+				resolution late unless the wheel's thread is busy.
+		*/
+		void schedule(timer &t, clock::time_point when)
+		{
+			std::lock_guard<std::mutex> lock(_mutex);
+
+			if (t.linked()) _unlink(t);
+			else
+			{
+				// An empty wheel catches up to the present at once.
+				if (!_count) _now = std::max(_now, _elapsed());
+				++_count;
+			}
+
+			t._tick = std::max(_tick_of(when), _now + 1);
+			_insert(t);
+
+			if (!_thread.joinable()) _thread = std::thread([this] {_run();});
+			if (t._tick < _wake_tick) _wake.notify_one();
+		}
+
+		/*
+			Cancel a timer.  Returns true if it was pending.
+				If the timer is expiring on another thread, waits for expire() to return.
+		*/
+		bool cancel(timer &t)
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+
+			while (_firing == &t && std::this_thread::get_id() != _thread.get_id()) _fired.wait(lock);
+
+			if (!t.linked()) return false;
+			_unlink(t);
+			--_count;
+			return true;
+		}
+
+		// Number of timers waiting to expire.
+		size_t pending() const    {std::lock_guard<std::mutex> lock(_mutex); return _count;}
+
+
+	private:
+		mutable std::mutex      _mutex;
+		std::condition_variable _wake, _fired;
+		std::thread             _thread;
+		bool                    _stop = false;
+
+		const clock::time_point _start;
+		uint64_t                _now       = 0;            // The last tick processed.
+		uint64_t                _wake_tick = ~uint64_t(0); // When the thread will next wake.
+		size_t                  _count     = 0;
+		const timer            *_firing    = nullptr;
+
+		link _slots[levels][slots];
+		link _due;
+
+
+		static void _clear(link &head) noexcept               {head.prev = head.next = &head;}
+		static bool _empty(const link &head) noexcept         {return head.next == &head;}
+		static void _unlink(link &l) noexcept                 {l.prev->next = l.next; l.next->prev = l.prev; l.prev = l.next = nullptr;}
+		static void _append(link &head, link &l) noexcept     {l.prev = head.prev; l.next = &head; head.prev->next = &l; head.prev = &l;}
+
+		// Ticks which have fully elapsed, and the first tick at or after a time.
+		uint64_t _elapsed() const noexcept    {return uint64_t((clock::now() - _start) / resolution);}
+		uint64_t _tick_of(clock::time_point when) const noexcept
+		{
+			if (when <= _start) return 0;
+			auto ticks = std::chrono::ceil<std::chrono::milliseconds>(when - _start) / resolution;
+			return uint64_t(ticks);
+		}
+
+		// File a timer at the level whose span covers its distance from now, or at the horizon.
+		void _insert(timer &t) noexcept
+		{
+			const uint64_t horizon = (uint64_t(1) << (slot_bits * levels)) - 1;
+			uint64_t tick  = std::min(t._tick, _now + horizon);
+			uint64_t delta = tick - _now;
+
+			unsigned level = 0;
+			while (level + 1 < levels && delta >= (uint64_t(1) << (slot_bits * (level + 1)))) ++level;
+
+			_append(_slots[level][(tick >> (slot_bits * level)) & (slots - 1)], t);
+		}
+
+		// Re-file the timers in one slot of an upper level.
+		void _cascade(unsigned level, uint64_t index) noexcept
+		{
+			link &head = _slots[level][index];
+			while (!_empty(head))
+			{
+				auto &t = static_cast<timer&>(*head.next);
+				_unlink(t);
+				_insert(t);
+			}
+		}
+
+		// Process the next tick, firing any timers which expire.
+		void _advance(std::unique_lock<std::mutex> &lock)
+		{
+			const uint64_t tick = ++_now;
+
+			for (unsigned level = 1; level < levels; ++level)
+			{
+				if (tick & ((uint64_t(1) << (slot_bits * level)) - 1)) break;
+				_cascade(level, (tick >> (slot_bits * level)) & (slots - 1));
+			}
+
+			link &slot = _slots[0][tick & (slots - 1)];
+			if (_empty(slot)) return;
+
+			// Move expiring timers to the due list, where cancel() can still reach them.
+			_due.next = slot.next; _due.prev = slot.prev;
+			_due.next->prev = &_due; _due.prev->next = &_due;
+			_clear(slot);
+
+			while (!_empty(_due))
+			{
+				auto &t = static_cast<timer&>(*_due.next);
+				_unlink(t);
+
+				// Timers beyond the horizon were filed at it; send them on.
+				if (t._tick > tick) {_insert(t); continue;}
+				--_count;
+
+				_firing = &t;
+				lock.unlock();
+				try            {t.expire();}
+				catch (...)    {}
+				lock.lock();
+				_firing = nullptr;
+				_fired.notify_all();
+			}
+		}
+
+		// The next tick with work to do: a slot with timers, or a level turning over.
+		uint64_t _next_event() const noexcept
+		{
+			for (uint64_t tick = _now + 1;; ++tick)
+				if (!(tick & (slots - 1)) || !_empty(_slots[0][tick & (slots - 1)])) return tick;
+		}
+
+		void _run()
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			while (!_stop)
+			{
+				if (!_count)
+				{
+					_wake_tick = ~uint64_t(0);
+					_wake.wait(lock);
+					continue;
+				}
+
+				for (uint64_t now = _elapsed(); _now < now && _count;) _advance(lock);
+				if (!_count) continue;
+
+				_wake_tick = _next_event();
+				_wake.wait_until(lock, _start + _wake_tick * resolution);
+			}
+		}
+	};
+
+
+	/*
+		PLEB's shared timer wheel, used for request deadlines.
+	*/
+	inline timer_wheel &default_timer_wheel()
+	{
+		static timer_wheel instance; return instance;
+	}
+}
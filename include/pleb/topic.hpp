@@ -1,12 +1,15 @@
 #pragma once
 
 #include <memory>
+#include <vector>
 #include <initializer_list>
 #include <string_view>
+#include <span>
 #include <type_traits>
 #include <functional>
 #include <iosfwd>
 #include <future>
+#include <chrono>
 
 #include "flags.hpp"
 #include "method.hpp"
@@ -51,6 +54,67 @@ namespace pleb
 	class service_relay;
 	using service_relay_ptr = std::shared_ptr<service_relay>;
 
+	using batch_service_function = std::function<void(std::span<request>)>;
+	using partition_key_function = std::function<std::string_view(const request&)>;
+
+	/*
+		Policies for choosing among the instances of a service group.
+			round_robin       -- rotate through live instances.
+			least_outstanding -- the instance with the fewest requests not yet answered.
+			affinity          -- each thread favors one instance.
+	*/
+	enum class balancing : uint8_t
+	{
+		round_robin,
+		least_outstanding,
+		affinity,
+	};
+
+	/*
+		How an event relay presents the events it forwards.
+			destination_topic -- subscribers receive a view of the event under the destination topic (default).
+			original_topic    -- subscribers receive the original event, with its topic.
+		Neither copies the event's content.
+	*/
+	enum class event_forwarding : uint8_t
+	{
+		destination_topic,
+		original_topic,
+	};
+
+	/*
+		What a queued subscription does when its mailbox is full.
+			drop_oldest -- the oldest waiting event is discarded.
+			drop_newest -- the new event is discarded.
+			block       -- the publisher waits for room.
+			coalesce    -- all waiting events are discarded; the consumer skips to the new one.
+	*/
+	enum class overflow_policy : uint8_t
+	{
+		drop_oldest,
+		drop_newest,
+		block,
+		coalesce,
+	};
+
+	struct mailbox_config
+	{
+		size_t          capacity = 1024;                        // Rounded up to a power of two.
+		overflow_policy overflow = overflow_policy::drop_oldest;
+		bool            manual   = false;                       // Drained by calling drain(), not on the executor.
+	};
+
+	/*
+		When a windowed batch subscription delivers its events:
+			once a window's worth have arrived, or once the delay has passed
+			since the first of them, whichever is sooner.
+	*/
+	struct batch_window
+	{
+		size_t                    events = 64;
+		std::chrono::microseconds delay  = std::chrono::milliseconds(1);   // Rounded up to the timer wheel's resolution.
+	};
+
 	class response;
 	class client;
 	using client_ptr = std::shared_ptr<client>;
@@ -60,8 +124,16 @@ namespace pleb
 	class subscription;
 	using subscription_ptr = std::shared_ptr<subscription>;
 	using subscriber_function = std::function<void(const event&)>;
+	using batch_subscriber_function = std::function<void(std::span<const event>)>;
 
 	class event_relay;
+	class queued_subscription;
+	class windowed_subscription;
+	class latest_subscription;
+	class conflation_group;
+	class shared_subscription;
+	class retention;
+	class event_history;
 	using event_relay_ptr = std::shared_ptr<event_relay>;
 
 	class resource_data;
@@ -71,6 +143,9 @@ namespace pleb
 	resource_node_ptr global_root_resource() noexcept;
 
 	class bound_service_function;
+
+	template<typename T> class future;
+	template<typename T> class task;
 	
 
 	/*
@@ -87,6 +162,8 @@ namespace pleb
 		// 2. Set the provided future to receive the response.
 		template<typename T>
 		client_ref(std::future<T> *f);
+		template<typename T>
+		client_ref(pleb::future<T> *f);
 
 		// 3. Provide a callback function to handle the response.
 		client_ref(response_function &&f);
@@ -351,6 +428,7 @@ namespace pleb
 		topic_base_(topic_base_<void>      &&o);
 		operator topic_base_<void>() const &       {return topic_base_<void>(_realize());}
 		operator topic_base_<void>() &&            {_realize(); return topic_base_<void>(std::move(_nearest));}
+		topic_base_ &operator=(const topic_base_<void> &o);
 
 		bool operator==(const topic_base_       &other) const    {return _path == other._path;}
 		bool operator!=(const topic_base_       &other) const    {return _path != other._path;}
@@ -529,6 +607,25 @@ namespace pleb
 			subscriber_function &&handler,
 			subscription_config   flags = {});
 
+		/*
+			SUBSCRIBE with a function accepting batches of events.
+				publish_batch delivers each batch subscriber its events in one call;
+				events published individually arrive as batches of one.
+		*/
+		[[nodiscard]] std::shared_ptr<subscription> subscribe_batch(
+			batch_subscriber_function &&handler,
+			subscription_config         flags = {});
+
+		/*
+			SUBSCRIBE with a function accepting batches of events, collected in windows.
+				Events are delivered in batches of up to window.events on the default
+				executor, once a batch is full or its delay has passed.  See window.hpp.
+		*/
+		[[nodiscard]] std::shared_ptr<windowed_subscription> subscribe_batch(
+			batch_subscriber_function &&handler,
+			batch_window                window,
+			subscription_config         flags = {});
+
 		/*
 			Subscribe to a resource via calls to a method of some object.
 		*/
@@ -550,24 +647,110 @@ namespace pleb
 			T              &&item      = {},
 			message_flags    flags     = {}) const;
 
+		/*
+			PUBLISH a batch of values as events, as by publish_batch below.
+		*/
+		template<typename Range>
+		void publish_batch(
+			pleb::status     status,
+			const Range     &items,
+			message_flags    flags     = {}) const;
+
+
+		/*
+			Subscribe with a mailbox, so events are delivered away from the publishing thread.
+				Events are delivered in order on the default executor, or by calls to drain().
+				See mailbox.hpp for overflow policies.
+		*/
+		[[nodiscard]] std::shared_ptr<queued_subscription> subscribe_queued(
+			subscriber_function &&handler,
+			mailbox_config        config = {},
+			subscription_config   flags  = {});
+
+		/*
+			Subscribe to only the newest event, which the consumer takes by calling drain().
+				Subscriptions sharing a conflation_group are drained together.
+				See conflation.hpp.
+		*/
+		[[nodiscard]] std::shared_ptr<latest_subscription> subscribe_latest(
+			subscriber_function               &&handler,
+			std::shared_ptr<conflation_group>   group = nullptr,
+			subscription_config                 flags = {});
+
+		/*
+			Subscribe as a member of the named consumer group at this topic.
+				Each event the group receives is delivered to only one live member,
+				chosen by a balancing policy; least_outstanding counts events being
+				handled.  The policy given most recently applies to the whole group.
+				See consumer_group.hpp.
+		*/
+		[[nodiscard]] std::shared_ptr<shared_subscription> subscribe_shared(
+			std::string_view      group,
+			subscriber_function &&handler,
+			balancing             policy = balancing::round_robin,
+			subscription_config   flags  = {});
 
 		/*
 			Create a subscription which re-publishes events to another topic.
 				Forwarding will continue as long as the returned pointer is held.
+				Events are passed on by reference; see event_relay.
 
 			Throws an exception if destination is a child of this topic,
 				unless the forwarder is configured to ignore recursive events.
 		*/
 		std::shared_ptr<event_relay> forward_events(
 			topic_path          destination_topic,
-			subscription_config flags = {});
+			subscription_config flags      = {},
+			event_forwarding    forwarding = event_forwarding::destination_topic);
+
+
+		/*
+			FAN OUT events published to this topic in parallel, once it has many subscribers.
+				While this topic has at least min_subscribers live subscriptions,
+				publish() divides it among the default executor's workers and waits for
+				them to finish.  Smaller lists are walked serially, as is publish_batch.
+				Zero disables parallel fan-out, the default.  See fan_out.hpp.
+		*/
+		void fan_out(size_t min_subscribers);
 
+		/*
+			RETAIN the last event published to each topic in this subtree.
+				New subscribers receive retained events when they subscribe,
+				including those of descendant topics if they accept recursive events.
+				Retention is bounded by a number of topics, and continues as long
+				as the returned pointer is held.  See retention.hpp.
+		*/
+		[[nodiscard]] std::shared_ptr<retention> retain(size_t max_topics);
+
+		/*
+			Get the event retained at this topic, if any.
+				This is a cheap alternative to a request for the topic's state.
+		*/
+		std::shared_ptr<const pleb::event> retained() const noexcept;
+
+		/*
+			RECORD the events published in this subtree in a ring of a given capacity.
+				Recording continues as long as the returned pointer is held.
+				See history.hpp.
+		*/
+		[[nodiscard]] std::shared_ptr<event_history> record(size_t capacity);
+
+		/*
+			Subscribe, first receiving the events in a history from a sequence number on.
+				Recorded events are replayed on this thread, before subscribe_replay returns;
+				events published while subscribing may be received twice.
+		*/
+		[[nodiscard]] std::shared_ptr<subscription> subscribe_replay(
+			const event_history &history,
+			uint64_t             from,
+			subscriber_function &&handler,
+			subscription_config  flags = {});
 
 
 		/*
 			SERVE this resource.
 				Subsequent events on this resource will be passed to the function.
-				If a service already exists here, this function will fail, returning null.
+				If a service or service group already exists here, this function will fail, returning null.
 		*/
 		[[nodiscard]] std::shared_ptr<service> serve(
 			service_function &&handler,
@@ -587,6 +770,59 @@ namespace pleb
 			service_config         flags = {});
 
 
+		/*
+			SERVE this resource with a function accepting batches of requests.
+				issue_batch delivers each batch service its requests in one call;
+				requests issued individually arrive as batches of one.
+		*/
+		[[nodiscard]] std::shared_ptr<service> serve_batch(
+			batch_service_function &&handler,
+			service_config           flags = {}) noexcept;
+
+
+		/*
+			SERVE this resource with a coroutine, eg:  pleb::task<void> handler(pleb::request&)
+				The handler may co_await other requests before responding.
+				PLEB claims the client and keeps a copy of the request alive
+				until the coroutine completes.  See coroutine.hpp.
+		*/
+		template<typename Handler,
+			typename = std::enable_if_t<std::is_same_v<std::invoke_result_t<Handler&, pleb::request&>, pleb::task<void>>>>
+		[[nodiscard]] std::shared_ptr<service> serve(
+			Handler       &&handler,
+			service_config  flags = {});
+
+
+		/*
+			SERVE this resource as one instance of a service group.
+				Requests are spread among the live instances by a balancing policy;
+				the policy given most recently applies to the whole group.
+				Fails, returning null, if this resource has an ordinary service.
+		*/
+		[[nodiscard]] std::shared_ptr<service> serve_group(
+			service_function &&handler,
+			service_config     flags  = {},
+			balancing          policy = balancing::round_robin);
+
+
+		/*
+			SERVE the subtopics of this resource with a number of shard handlers.
+				The shard is chosen by hashing a key, so requests with the same key
+				always reach the same shard.  By default the key is a path segment
+				below this topic (0 being the first); requests lacking it use an empty key.
+				Alternatively a function may extract the key from each request.
+		*/
+		[[nodiscard]] std::shared_ptr<service> serve_partitioned(
+			std::vector<service_function> shards,
+			size_t                        key_segment = 0,
+			service_config                flags       = pleb::flags::default_receiver_ignore);
+
+		[[nodiscard]] std::shared_ptr<service> serve_partitioned(
+			std::vector<service_function> shards,
+			partition_key_function        key,
+			service_config                flags       = pleb::flags::default_receiver_ignore);
+
+
 		/*
 			Create a service which forwards requests to another topic.
 				Forwarding will continue as long as the returned pointer is held.
@@ -622,6 +858,7 @@ namespace pleb
 
 			The returned request may be issued (sent) by:
 			- calling async<T> or converting to std::future<T>
+			- calling send<T> or converting to pleb::future<T>
 			- calling await<T>
 			- calling push() or issue(client) -- auto_retrieve only.
 		*/
@@ -671,6 +908,14 @@ namespace pleb
 		*/
 		void publish(const pleb::event &msg) const;
 
+		/*
+			PUBLISH a batch of prepared events, in order, as if published one by one.
+				The topic is resolved and its subscribers walked once for the batch.
+				Batch subscribers receive the events they accept in as few calls as
+				possible; other subscribers receive them one at a time.
+		*/
+		void publish_batch(std::span<const pleb::event> events) const;
+
 
 
 		/*
@@ -735,7 +980,28 @@ namespace pleb
 
 	protected:
 		template<typename P> friend class topic_;
+		friend class pleb::subscription;
+		friend class queued_subscription;
+		friend class windowed_subscription;
+		friend class latest_subscription;
+		friend class consumer_group;
 		void _publish_exception(const pleb::event&, const subscription&, std::exception_ptr) const;
+
+		// Announce a new receiver to discovery subscriptions; see announcement.hpp.
+		void _announce(const subscription_ptr&) const;
+		void _announce(const service_ptr&) const;
+
+		// Deliver retained events to a new subscriber.
+		static void _replay_retained(const resource_node_ptr&, const subscription_ptr&, flags::filtering recursion = {});
+
+		// Let caches, retentions and histories take note of published events.
+		static void _note_published(const topic_ &target, const resource_node_ptr &nearest, std::span<const pleb::event>);
+
+		// Whether a cache, retention or history may take note of events published here.
+		static bool _noting(const resource_node_ptr &nearest) noexcept;
+
+		// Call a subscriber with a run of events.
+		static void _call_subscriber(subscription&, std::span<const pleb::event>);
 	};
 
 
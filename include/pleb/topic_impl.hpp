@@ -1,8 +1,22 @@
 #pragma once
 
 
+#include <span>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+
 #include "bind.hpp"
 #include "resource_node.hpp"
+#include "executor.hpp"
+#include "fan_out.hpp"
+#include "mailbox.hpp"
+#include "window.hpp"
+#include "conflation.hpp"
+#include "consumer_group.hpp"
+#include "retention.hpp"
+#include "history.hpp"
+#include "announcement.hpp"
 
 
 /*
@@ -46,6 +60,13 @@ namespace pleb
 		_path = _nearest->path();
 	}
 
+	inline topic_base_<lazy_path> &topic_base_<lazy_path>::operator=(const topic_base_<void> &o)
+	{
+		// Reuses the path's storage, which usually suffices.
+		_nearest = null_topic_error::check(o._node, "can't make topic_path", "(null topic)");
+		_path.assign(_nearest->path());
+		return *this;
+	}
 	inline topic_base_<lazy_path>::topic_base_(const resource_node_ptr &node)
 		:
 		_nearest(null_topic_error::check(node, "can't make topic_path")),
@@ -144,7 +165,53 @@ namespace pleb
 		auto &node = this->_realize();
 		if constexpr (type_can_be_null) null_topic_error::check(node, "can't subscribe", "(null topic)");
 		auto ptr = node->emplace_subscriber(node, std::move(f), flags);
-		publish(statuses::Created, ptr, flags::announce_receiver | flags::recursive);
+		_announce(ptr);
+		_replay_retained(node, ptr);
+		return ptr;
+	}
+
+	template<typename P> [[nodiscard]]
+	std::shared_ptr<subscription> topic_<P>::subscribe_batch(
+		batch_subscriber_function &&f,
+		subscription_config         flags)
+	{
+		auto &node = this->_realize();
+		if constexpr (type_can_be_null) null_topic_error::check(node, "can't subscribe", "(null topic)");
+		auto ptr = node->emplace_subscriber(node, std::move(f), flags);
+		_announce(ptr);
+		_replay_retained(node, ptr);
+		return ptr;
+	}
+
+	template<typename P> [[nodiscard]]
+	std::shared_ptr<subscription> topic_<P>::subscribe_replay(
+		const event_history &history,
+		uint64_t             from,
+		subscriber_function &&f,
+		subscription_config  flags)
+	{
+		auto &node = this->_realize();
+		if constexpr (type_can_be_null) null_topic_error::check(node, "can't subscribe", "(null topic)");
+		auto ptr = node->emplace_subscriber(node, std::move(f), flags);
+		_announce(ptr);
+
+		// Replay the events this subscription would have received.
+		std::string_view path = node->path();
+		history.replay(from, [&](const pleb::event &e, const topic_path &published)
+		{
+			std::string_view at = published.path();
+			auto filtering = e.filtering & ~flags::recursive;
+			if (at.length() > path.length())
+			{
+				if (!e.recursive() || at.substr(0, path.length()) != path || (path.length() && at[path.length()] != '/')) return;
+				filtering |= flags::recursive;
+			}
+			else if (at != path) return;
+
+			if (!ptr->accepts(filtering)) return;
+			try            {ptr->func(e);}
+			catch (...)    {ptr->topic._publish_exception(e, *ptr, std::current_exception());}
+		});
 		return ptr;
 	}
 
@@ -173,6 +240,21 @@ namespace pleb
 		publish(e);
 	}
 
+	template<typename P>
+	template<typename Range>
+	void topic_<P>::publish_batch(
+		status           status,
+		const Range     &items,
+		message_flags    flags) const
+	{
+		if constexpr (type_can_be_null) null_topic_error::check(base_t::_nearest_node(), "can't publish", "(null topic)");
+		topic_path               path(*this);
+		std::vector<pleb::event> events;
+		events.reserve(std::size(items));
+		for (auto &item : items) events.emplace_back(path, status, item, flags);
+		publish_batch(events);
+	}
+
 	template<typename P> [[nodiscard]]
 	std::shared_ptr<service> topic_<P>::serve(
 		service_function &&function,
@@ -181,7 +263,32 @@ namespace pleb
 		auto &node = this->_realize();
 		if constexpr (type_can_be_null) null_topic_error::check(node, "can't serve", "(null topic)");
 		auto ptr = node->try_emplace_service(node, std::move(function), flags);
-		if (ptr) publish(statuses::Created, ptr, flags::announce_receiver | flags::recursive);
+		if (ptr) _announce(ptr);
+		return ptr;
+	}
+
+	template<typename P> [[nodiscard]]
+	std::shared_ptr<service> topic_<P>::serve_batch(
+		batch_service_function &&function,
+		service_config           flags) noexcept
+	{
+		auto &node = this->_realize();
+		if constexpr (type_can_be_null) null_topic_error::check(node, "can't serve", "(null topic)");
+		auto ptr = node->try_emplace_service(node, std::move(function), flags);
+		if (ptr) _announce(ptr);
+		return ptr;
+	}
+
+	template<typename P> [[nodiscard]]
+	std::shared_ptr<service> topic_<P>::serve_group(
+		service_function &&function,
+		service_config     flags,
+		balancing          policy)
+	{
+		auto &node = this->_realize();
+		if constexpr (type_can_be_null) null_topic_error::check(node, "can't serve", "(null topic)");
+		auto ptr = node->emplace_group_service(node, std::move(function), flags, policy);
+		if (ptr) _announce(ptr);
 		return ptr;
 	}
 
@@ -193,6 +300,38 @@ namespace pleb
 		return serve(std::move(handler.handler), flags);
 	}
 
+	template<typename P> [[nodiscard]]
+	std::shared_ptr<service> topic_<P>::serve_partitioned(
+		std::vector<service_function> shards,
+		size_t                        key_segment,
+		service_config                flags)
+	{
+		// Skip the segments of this topic, then take the key segment.
+		size_t skip = key_segment;
+		for (auto i = topic_view(this->path()).begin(); i; ++i) ++skip;
+
+		return serve_partitioned(std::move(shards), [skip](const pleb::request &r) -> std::string_view
+		{
+			size_t n = skip;
+			for (auto part : topic_view(r.topic.path())) if (!n--) return part;
+			return {};
+		}, flags);
+	}
+
+	template<typename P> [[nodiscard]]
+	std::shared_ptr<service> topic_<P>::serve_partitioned(
+		std::vector<service_function> shards,
+		partition_key_function        key,
+		service_config                flags)
+	{
+		if (shards.empty()) throw std::logic_error("A partitioned service needs at least one shard.");
+
+		return serve([shards = std::move(shards), key = std::move(key)](pleb::request &r)
+		{
+			shards[std::hash<std::string_view>()(key(r)) % shards.size()](r);
+		}, flags);
+	}
+
 	template<typename P>
 	template<class V>
 	void topic_<P>::request(client_ref client, method method, V &&value) const
@@ -229,6 +368,192 @@ namespace pleb
 	template<typename P>
 	/* */             auto_request topic_<P>::DELETE()          const    {return request(method::DELETE);}
 
+	namespace detail
+	{
+		/*
+			Client which counts its request as outstanding at a service until it is answered or released.
+		*/
+		class outstanding_client : public client
+		{
+		public:
+			outstanding_client(service_ptr svc, client_ptr next)
+				:
+				client([this](response &r) {if (!_answered.exchange(true)) _occupied.reset(); if (_next) _next->deliver(r);}, flags::realtime),
+				_svc(std::move(svc)), _occupied(std::in_place, *_svc), _next(std::move(next)) {}
+
+			bool is_cancelled() const noexcept override           {return _next && _next->is_cancelled();}
+			void on_cancel(std::function<void()> callback) override    {if (_next) _next->on_cancel(std::move(callback));}
+
+
+		private:
+			service_ptr                       _svc; // Outlives the count.
+			std::optional<service::occupancy> _occupied;
+			client_ptr                        _next;
+			std::atomic<bool>                 _answered = false;
+		};
+
+		/*
+			Count a request at a service until it is answered, if the service wants that.
+				Returns 1 if the request's client now does so, or else 0, in which case the
+				request should be counted while it is handled.  Immediate requests, whose
+				clients may not be claimed, are counted while handled.
+		*/
+		inline size_t count_until_answered(const service_ptr &svc, pleb::request &msg)
+		{
+			if (!svc->counts_until_answered() || (msg.requirements & flags::immediate)) return 0;
+
+			client_ptr client = msg.exchange_client(nullptr);
+			if (!client || !client.use_count()) {msg.exchange_client(std::move(client)); return 0;}
+			msg.exchange_client(std::make_shared<outstanding_client>(svc, std::move(client)));
+			return 1;
+		}
+
+		/*
+			Deliver a request to a service with admission limits.
+				With a turn available, requests are handled at once: on this
+				thread, or on the executor if the service is pooled, keeping the
+				turn until handled.  Others wait for a turn on the executor if
+				the queue has room, and are otherwise rejected.
+				Immediate requests cannot wait.
+		*/
+		inline void dispatch_admitted(const service_ptr &svc, admission &adm, pleb::request &msg, size_t counted)
+		{
+			const bool immediate = (msg.requirements & flags::immediate);
+			const bool pooled    = (svc->handling & flags::pooled) && !immediate;
+
+			if (adm.try_begin())
+			{
+				admission::turn    taken(adm);
+				service::occupancy occupied(*svc, counted);
+				if (!pooled) return svc->handle(msg);
+
+				pleb::request running(msg);
+				running.exchange_client(msg.claim_client());
+				msg.features |= flags::did_respond;
+
+				default_executor().post([svc, running = std::move(running), taken = std::move(taken), occupied = std::move(occupied)]() mutable
+				{
+					auto turn = std::move(taken); // Ends before svc is released.
+					svc->handle(running);
+				});
+				return;
+			}
+
+			if (immediate || !adm.try_enqueue()) return svc->reject(msg);
+
+			pleb::request waiting(msg);
+			waiting.exchange_client(msg.claim_client());
+			msg.features |= flags::did_respond;
+
+			adm.park([svc, &adm, waiting = std::move(waiting), occupied = service::occupancy(*svc, counted)]() mutable
+			{
+				admission::turn taken(adm);
+				svc->handle(waiting);
+			});
+		}
+
+		/*
+			Deliver a request, or a batch for one service, to that service.
+				Pooled services receive copies of the requests on the default
+				executor; the copies take over the clients.
+		*/
+		inline void dispatch(const service_ptr &svc, pleb::request &msg)
+		{
+			if (svc->answer_from_cache(msg) || svc->join_flight(msg)) return;
+			svc->prepare_cache(msg);
+			const size_t counted = 1 - count_until_answered(svc, msg);
+
+			if (auto *adm = svc->admission_control()) return dispatch_admitted(svc, *adm, msg, counted);
+
+			if ((svc->handling & flags::pooled) && !(msg.requirements & flags::immediate))
+			{
+				// The copy's client is bounded by the deadline while it waits.
+				pleb::request pooled(msg);
+				pooled.exchange_client(msg.claim_client());
+				msg.features |= flags::did_respond;
+
+				service::occupancy occupied(*svc, counted);
+				default_executor().post([svc, pooled = std::move(pooled), occupied = std::move(occupied)]() mutable
+				{
+					svc->handle(pooled);
+				});
+			}
+			else
+			{
+				service::occupancy occupied(*svc, counted);
+				svc->handle(msg);
+			}
+		}
+
+		inline void dispatch(const service_ptr &svc, std::span<pleb::request> batch)
+		{
+			if (batch.size() == 1) return dispatch(svc, batch.front());
+
+			// Batches bypass cache lookups, but still fill and invalidate the cache.
+			size_t counted = batch.size();
+			for (auto &msg : batch) {svc->prepare_cache(msg); counted -= count_until_answered(svc, msg);}
+
+			if (svc->handling & flags::pooled)
+			{
+				bool immediate = false;
+				for (auto &msg : batch) if (msg.requirements & flags::immediate) immediate = true;
+
+				if (!immediate)
+				{
+					std::vector<pleb::request> pooled(batch.begin(), batch.end());
+					for (size_t i = 0; i < batch.size(); ++i) {pooled[i].exchange_client(batch[i].claim_client()); batch[i].features |= flags::did_respond;}
+
+					service::occupancy occupied(*svc, counted);
+					default_executor().post([svc, pooled = std::move(pooled), occupied = std::move(occupied)]() mutable
+					{
+						svc->handle(std::span<pleb::request>(pooled));
+					});
+					return;
+				}
+			}
+
+			service::occupancy occupied(*svc, counted);
+			svc->handle(batch);
+		}
+	}
+
+	inline service_relay::route service_relay::resolve(flags::filtering filtering) const
+	{
+		const size_t generation = detail::service_generation().load(std::memory_order_acquire);
+		if (auto cached = _route.load(std::memory_order_acquire))
+			if (cached->generation == generation && cached->filtering == filtering)
+				if (service_ptr svc = cached->endpoint.lock()) return {std::move(svc), cached->destination};
+
+		route found;
+		const service_relay *relay = this;
+		service_ptr          held;
+		for (size_t hops = 1;; ++hops)
+		{
+			found.destination = relay->target;
+			service_ptr next = relay->target.find_service(filtering);
+			if (!next || !next->is_relay()) {found.service = std::move(next); break;}
+			if (hops == max_hops)           {found.looped  = true;            break;}
+			held  = std::move(next);
+			relay = static_cast<const service_relay*>(held.get());
+		}
+
+		// Instances of a service group are chosen anew for each request.
+		if (found.service && found.service->topic.current_service() == found.service)
+			_route.store(std::make_shared<const _cached_route>(_cached_route{found.service, found.destination, filtering, generation}),
+				std::memory_order_release);
+		return found;
+	}
+
+	inline void service_relay::forward(pleb::request &msg) const
+	{
+		route via = resolve(msg.filtering);
+		if (via.looped)   {msg.respond(statuses::LoopDetected); return;}
+		if (!via.service) throw service_not_found("No service available", via.destination.path());
+
+		msg.redirect(via.destination);
+		detail::dispatch(via.service, msg);
+	}
+
 	template<typename P>
 	void topic_<P>::issue(pleb::request &msg) const
 	{
@@ -237,14 +562,8 @@ namespace pleb
 
 		if (service_ptr svc = find_service(msg.filtering))
 		{
-			try                            {svc->func(msg);}
-			catch (status s)               {msg.respond(s);}
-			catch (statuses s)             {msg.respond(s);}
-			catch (status_exception &e)    {msg.respond(e.status);}
-
-			// Default response if service did not respond or move message.
-			if (!(msg.features & flags::did_respond)) msg.respond(statuses::NoContent);
-
+			if (svc->is_relay()) static_cast<const service_relay&>(*svc).forward(msg);
+			else                 detail::dispatch(svc, msg);
 			msg.features |= flags::did_send;
 		}
 		else
@@ -253,6 +572,136 @@ namespace pleb
 		}
 	}
 
+	/*
+		Issue many requests in one pass.
+			Each distinct topic is resolved to its service once.
+			Services which accept batches are called once with all of their
+			requests, in their order within the batch; these are gathered into
+			a contiguous span when they are interleaved with others, and put
+			back afterward, so the caller's requests keep their order.  Other
+			services are called once per request.  Relays are resolved to the
+			services they lead to.
+
+			Unlike issue(), which throws service_not_found, requests for which no
+			service exists are answered NotFound, so that one missing topic does
+			not fail the rest of the batch.  Relays which loop are answered LoopDetected.
+	*/
+	inline void issue_batch(std::span<pleb::request> requests)
+	{
+		struct route
+		{
+			service_ptr svc;
+			pleb::topic destination;
+			bool        relayed = false;
+			status      missing = statuses::NotFound;
+			size_t      group   = ~size_t(0);  // Index into groups, for batch services.
+		};
+		struct route_key
+		{
+			std::string_view path;
+			flags::filtering filtering;
+
+			bool operator==(const route_key&) const noexcept = default;
+		};
+		struct route_hash
+		{
+			size_t operator()(const route_key &k) const noexcept    {return std::hash<std::string_view>()(k.path) ^ size_t(k.filtering);}
+		};
+
+		// A topic path names one resource, so routes are found by path and filtering.
+		std::unordered_map<route_key, size_t, route_hash> route_index;
+		std::unordered_map<const service*, size_t>        group_index;
+		std::vector<route>                                routes;
+		std::vector<std::vector<size_t>>                  groups;      // Requests for each batch service, in order.
+		std::vector<size_t>                               route_of(requests.size());
+
+		for (size_t i = 0; i < requests.size(); ++i)
+		{
+			auto &msg = requests[i];
+			msg.features &= ~flags::did_respond;
+
+			auto [found, added] = route_index.try_emplace(route_key{msg.topic.path(), msg.filtering}, routes.size());
+			if (added)
+			{
+				route &r = routes.emplace_back();
+				r.svc = msg.topic.find_service(msg.filtering);
+				if (r.svc && r.svc->is_relay())
+				{
+					auto via = static_cast<const service_relay&>(*r.svc).resolve(msg.filtering);
+					r.svc         = std::move(via.service);
+					r.relayed     = true;
+					r.destination = std::move(via.destination);
+					if (via.looped) r.missing = statuses::LoopDetected;
+				}
+				if (r.svc && r.svc->is_batch())
+				{
+					auto [group, created] = group_index.try_emplace(r.svc.get(), groups.size());
+					if (created) groups.emplace_back();
+					r.group = group->second;
+				}
+			}
+			route_of[i] = found->second;
+			if (routes[found->second].group != ~size_t(0)) groups[routes[found->second].group].push_back(i);
+		}
+
+		// Requests are redirected after all are routed, as the route index refers to their paths.
+		for (size_t i = 0; i < requests.size(); ++i)
+			if (routes[route_of[i]].relayed) requests[i].redirect(routes[route_of[i]].destination);
+
+		// Deliver each batch service its requests together, when the first of them is reached.
+		auto deliver_group = [&](const service_ptr &svc, const std::vector<size_t> &members)
+		{
+			if (members.back() - members.front() + 1 == members.size())
+			{
+				auto batch = requests.subspan(members.front(), members.size());
+				detail::dispatch(svc, batch);
+				for (auto &msg : batch) msg.features |= flags::did_send;
+				return;
+			}
+
+			std::vector<pleb::request> gathered;
+			gathered.reserve(members.size());
+			for (size_t m : members) gathered.push_back(std::move(requests[m]));
+			auto put_back = [&] {for (size_t k = 0; k < members.size(); ++k) requests[members[k]] = std::move(gathered[k]);};
+
+			try            {detail::dispatch(svc, std::span<pleb::request>(gathered));}
+			catch (...)    {put_back(); throw;}
+			for (auto &msg : gathered) msg.features |= flags::did_send;
+			put_back();
+		};
+
+		std::vector<bool> dispatched(groups.size(), false);
+		for (size_t i = 0; i < requests.size(); ++i)
+		{
+			const route &r = routes[route_of[i]];
+			if (r.group != ~size_t(0))
+			{
+				if (!dispatched[r.group]) {dispatched[r.group] = true; deliver_group(r.svc, groups[r.group]);}
+				continue;
+			}
+
+			if (r.svc) detail::dispatch(r.svc, requests[i]);
+			else       requests[i].respond(r.missing);
+			requests[i].features |= flags::did_send;
+		}
+	}
+
+	/*
+		GET several topics at once, by way of issue_batch.
+			Futures are returned in the same order as the topics.
+	*/
+	template<typename Response = pleb::response>
+	std::vector<pleb::future<Response>> get_batch(std::span<const topic_path> topics)
+	{
+		std::vector<pleb::future<Response>> futures(topics.size());
+		std::vector<pleb::request>          requests;
+		requests.reserve(topics.size());
+		for (size_t i = 0; i < topics.size(); ++i) requests.emplace_back(&futures[i], topics[i], method::GET);
+		issue_batch(requests);
+		return futures;
+	}
+
+
 	/*
 		PUBLISH using a prepared pleb::event object.
 			pleb::event usually calls this method upon construction;
@@ -269,6 +718,51 @@ namespace pleb
 
 		const bool recursive = msg.recursive();
 		auto filtering = msg.filtering & ~flags::recursive;
+
+		const bool pooled = !(msg.requirements & flags::immediate);
+		std::shared_ptr<const pleb::event> shared_event;
+
+		// Deliver to one subscription, given an iterator or pointer which can retain it.
+		auto deliver = [&msg, pooled](const auto &ref, std::shared_ptr<const pleb::event> &shared_event)
+		{
+			subscription &sub = *ref;
+			switch (sub.delivery)
+			{
+			case delivery_mode::direct:
+				break;
+
+			case delivery_mode::queued:
+				// Queued and pooled subscribers share one copy of the event.
+				if (!shared_event) shared_event = detail::share_event(msg);
+				static_cast<queued_subscription&>(sub).enqueue(shared_event);
+				return;
+
+			case delivery_mode::latest:
+				static_cast<latest_subscription&>(sub).store(msg);
+				return;
+			}
+			if (pooled && (sub.handling & flags::pooled))
+			{
+				if (!shared_event) shared_event = detail::share_event(msg);
+
+				default_executor().post([sub = subscription_ptr(ref), ev = shared_event]()
+				{
+					try            {sub->func(*ev);}
+					catch (...)    {sub->topic._publish_exception(*ev, *sub, std::current_exception());}
+				});
+				return;
+			}
+
+			try            {sub.func(msg);}
+			catch (...)    {sub.topic._publish_exception(msg, sub, std::current_exception());}
+		};
+
+		// Nothing to do if nothing subscribes, caches, retains or records here or above.
+		const bool observed = resource_data::observed(node);
+		if (!observed && !_noting(node)) return;
+
+		_note_published(target, node, std::span<const pleb::event>(&msg, 1));
+		if (!observed) return;
 		
 		if (target._is_resolved()) goto start_resolved;
 
@@ -277,16 +771,191 @@ namespace pleb
 			filtering |= flags::recursive;
 
 		start_resolved:
-			for (subscription &sub : node->subscriptions()) if (sub.accepts(filtering))
+			if (size_t min = node->fan_out(); min && node->subscription_count() >= min)
 			{
-				try            {sub.func(msg);}
-				catch (...)    {sub.topic._publish_exception(msg, sub, std::current_exception());}
+				// Each part of a parallel fan-out makes its own shared copy of the event, if needed.
+				auto &exec  = default_executor();
+				size_t parts = exec.thread_count() + 1;
+				std::vector<std::shared_ptr<const pleb::event>> part_events(parts);
+				detail::parallel_visit(node->subscriptions(), parts, exec,
+					[&deliver, &part_events, filtering](const subscription_ptr &sub, size_t part)
+				{
+					if (sub->accepts(filtering)) deliver(sub, part_events[part]);
+				});
 			}
+			else for (auto i = node->subscriptions().begin(), e = node->subscriptions().end(); i != e; ++i)
+				if (i->accepts(filtering)) deliver(i, shared_event);
 
 			node = node->parent();
 		}
 	}
 
+	template<typename P>
+	bool topic_<P>::_noting(const resource_node_ptr &nearest) noexcept
+	{
+		return (detail::response_cache::any_live() && resource_data::caching(nearest))
+			|| ((retention::any_live() || event_history::any_live()) && resource_data::noted(nearest));
+	}
+
+	/*
+		Let caches, retentions and histories take note of published events.
+	*/
+	template<typename P>
+	void topic_<P>::_note_published(
+		const topic_<P>               &target,
+		const resource_node_ptr       &nearest,
+		std::span<const pleb::event>   events)
+	{
+		auto announced = [](const pleb::event &e) {return e.filtering & flags::announce_receiver;};
+		auto internal  = [](const pleb::event &e) {return e.filtering & (flags::announce_receiver | flags::subscriber_exception);};
+		auto copyable  = [](const pleb::event &e) {return !(e.requirements & flags::no_copying);};
+
+		// An event published to a caching service's topic invalidates its cached responses.
+		if (detail::response_cache::any_live() && resource_data::caching(nearest) && !std::all_of(events.begin(), events.end(), internal))
+			if (auto svc = target.find_service(flags::default_message_filtering)) svc->invalidate_cache(target.path());
+
+		// The last event published within a retaining subtree is kept for later subscribers.
+		if (retention::any_live() && resource_data::noted(nearest))
+			for (auto e = events.rbegin(); e != events.rend(); ++e) if (!internal(*e) && copyable(*e))
+			{
+				if (auto r = retention::find(nearest)) r->store(target._is_resolved() ? nearest : resource_node_ptr(target._realize()), *e);
+				break;
+			}
+
+		// An event published within a recorded subtree is added to its history.
+		if (event_history::any_live() && resource_data::noted(nearest))
+			if (auto h = event_history::find(nearest))
+			{
+				std::optional<topic_path> published;
+				for (auto &e : events) if (!announced(e) && copyable(e))
+				{
+					if (target.path() == e.topic.path()) {h->record(e); continue;}
+					if (!published) published.emplace(target);
+					h->record(e, &*published);
+				}
+			}
+	}
+
+	/*
+		PUBLISH a batch of prepared events.
+			The subscribers are walked once, and each receives the runs of
+			events it accepts; see publish(const pleb::event&).
+	*/
+	template<typename P>
+	void topic_<P>::publish_batch(std::span<const pleb::event> events) const
+	{
+		if (events.empty()) return;
+
+		const topic_<P>  &target = base_t::_resolve();
+		resource_node_ptr node   = target._nearest_node();
+
+		if constexpr (type_can_be_null)
+			null_topic_error::check(node, "can't publish event", "(null topic)");
+
+		bool recursive = false, pooled = true;
+		for (auto &e : events)
+		{
+			recursive |= e.recursive();
+			pooled    &= !(e.requirements & flags::immediate);
+		}
+
+		const bool observed = resource_data::observed(node);
+		if (!observed && !_noting(node)) return;
+
+		_note_published(target, node, events);
+		if (!observed) return;
+
+		// Queued and pooled subscribers share one copy of the batch.
+		std::shared_ptr<const std::vector<pleb::event>> shared_batch;
+		auto share = [&]() -> const std::shared_ptr<const std::vector<pleb::event>>&
+		{
+			if (!shared_batch)
+			{
+				auto copy = std::make_shared<std::vector<pleb::event>>(events.begin(), events.end());
+				for (auto &e : *copy) detail::own_content(e);
+				shared_batch = std::move(copy);
+			}
+			return shared_batch;
+		};
+
+		// Deliver a run of consecutive events to one subscriber.
+		auto deliver = [&](const auto &i, size_t first, size_t last)
+		{
+			subscription &sub = *i;
+			auto          run = events.subspan(first, last - first);
+			switch (sub.delivery)
+			{
+			case delivery_mode::direct:
+				break;
+
+			case delivery_mode::queued:
+				for (size_t k = first; k < last; ++k)
+					static_cast<queued_subscription&>(sub).enqueue(std::shared_ptr<const pleb::event>(share(), &(*share())[k]));
+				return;
+
+			case delivery_mode::latest:
+				{
+					auto &latest = static_cast<latest_subscription&>(sub);
+					latest._conflated.fetch_add(run.size() - 1, std::memory_order_relaxed);
+					latest.store(run.back());
+				}
+				return;
+			}
+			if (pooled && (sub.handling & flags::pooled))
+			{
+				default_executor().post([sub = subscription_ptr(i), batch = share(), first, last]()
+				{
+					_call_subscriber(*sub, std::span<const pleb::event>(*batch).subspan(first, last - first));
+				});
+				return;
+			}
+			_call_subscriber(sub, run);
+		};
+
+		// Beyond the target, only recursive events are delivered.
+		auto filtering = flags::filtering(0);
+
+		if (target._is_resolved()) goto start_resolved;
+
+		while (recursive && node)
+		{
+			filtering = flags::recursive;
+
+		start_resolved:
+			for (auto i = node->subscriptions().begin(), e = node->subscriptions().end(); i != e; ++i)
+			{
+				auto accepts = [&](const pleb::event &ev)
+				{
+					return (!filtering || ev.recursive()) && i->accepts((ev.filtering & ~flags::recursive) | filtering);
+				};
+				for (size_t first = 0, last; first < events.size(); first = last)
+				{
+					if (!accepts(events[first])) {last = first + 1; continue;}
+					for (last = first + 1; last < events.size() && accepts(events[last]); ++last) {}
+					deliver(i, first, last);
+				}
+			}
+
+			node = node->parent();
+		}
+	}
+
+	// Call a subscriber with a run of events, in one call if it accepts batches.
+	template<typename P>
+	void topic_<P>::_call_subscriber(subscription &sub, std::span<const pleb::event> run)
+	{
+		if (sub.is_batch())
+		{
+			try            {sub.batch_func(run);}
+			catch (...)    {sub.topic._publish_exception(run.front(), sub, std::current_exception());}
+		}
+		else for (auto &e : run)
+		{
+			try            {sub.func(e);}
+			catch (...)    {sub.topic._publish_exception(e, sub, std::current_exception());}
+		}
+	}
+
 	template<>
 	inline void topic_<void>::_publish_exception(
 		const pleb::event  &msg,
@@ -307,6 +976,204 @@ namespace pleb
 		// TODO what if nobody handled the exception??  Unsafe to proceed?
 	}
 
+	template<typename P>
+	void topic_<P>::_announce(const subscription_ptr &receiver) const
+	{
+		if (!detail::announcement_listeners().load(std::memory_order_seq_cst)) return;
+		if (auto *batch = announcement_batch::_collecting()) batch->_collect(receiver);
+		else publish(statuses::Created, receiver, flags::announce_receiver | flags::recursive);
+	}
+
+	template<typename P>
+	void topic_<P>::_announce(const service_ptr &receiver) const
+	{
+		if (!detail::announcement_listeners().load(std::memory_order_seq_cst)) return;
+		if (auto *batch = announcement_batch::_collecting()) batch->_collect(receiver);
+		else publish(statuses::Created, receiver, flags::announce_receiver | flags::recursive);
+	}
+
+	template<typename P>
+	void topic_<P>::_replay_retained(
+		const resource_node_ptr &node,
+		const subscription_ptr  &sub,
+		flags::filtering         recursion)
+	{
+		// Subtrees without retained events are skipped.
+		if (!retention::any_live() || !node->_retained_below.load(std::memory_order_relaxed)) return;
+
+		if (auto e = node->retained()) if (!recursion || e->recursive())
+			if (sub->accepts((e->filtering & ~flags::recursive) | recursion)) switch (sub->delivery)
+		{
+		case delivery_mode::queued:
+			static_cast<queued_subscription&>(*sub).enqueue(e);
+			break;
+
+		case delivery_mode::latest:
+			static_cast<latest_subscription&>(*sub).store(*e);
+			break;
+
+		case delivery_mode::direct:
+			if (!(e->requirements & flags::immediate) && (sub->handling & flags::pooled))
+			{
+				default_executor().post([sub, e]()
+				{
+					try            {sub->func(*e);}
+					catch (...)    {sub->topic._publish_exception(*e, *sub, std::current_exception());}
+				});
+			}
+			else
+			{
+				try            {sub->func(*e);}
+				catch (...)    {sub->topic._publish_exception(*e, *sub, std::current_exception());}
+			}
+			break;
+		}
+
+		// Events from descendants are recursive.  Collect children first, as visiting locks them.
+		if (!sub->accepts(flags::recursive)) return;
+		std::vector<resource_node_ptr> children;
+		node->visit_children([&](const std::string&, resource_node_ptr child)
+		{
+			// Links are not descendants.
+			if (child->parent() == node) children.push_back(std::move(child));
+		});
+		for (auto &child : children) _replay_retained(child, sub, flags::recursive);
+	}
+
+	inline size_t queued_subscription::drain(size_t limit)
+	{
+		if (_draining.exchange(true, std::memory_order_acquire)) return 0;
+
+		size_t n = 0;
+		for (std::shared_ptr<const event> e; n < limit; ++n)
+		{
+			if (!_ring.try_pop(e)) break;
+			try            {_consumer(*e);}
+			catch (...)    {topic._publish_exception(*e, *this, std::current_exception());}
+		}
+		_draining.store(false, std::memory_order_release);
+		return n;
+	}
+
+	inline size_t windowed_subscription::flush()
+	{
+		if (_flushing.exchange(true, std::memory_order_acquire)) return 0;
+
+		for (std::optional<pleb::event> item; _batch.size() < window.events && _ring.try_pop(item);)
+			_batch.push_back(std::move(*item));
+
+		size_t n = _batch.size();
+		if (n)
+		{
+			try            {_consumer(std::span<const pleb::event>(_batch));}
+			catch (...)    {topic._publish_exception(_batch.front(), *this, std::current_exception());}
+			_pending.fetch_sub(n, std::memory_order_acq_rel);
+			_batch.clear();
+		}
+		_flushing.store(false, std::memory_order_release);
+		return n;
+	}
+
+	inline void subscription::_count(int delta) noexcept
+	{
+		if (auto &node = topic._nearest_node())
+		{
+			// Only the first subscription at a resource or the loss of its last can change what is observed.
+			size_t prior = node->_subscribers.fetch_add(size_t(ptrdiff_t(delta)), std::memory_order_seq_cst);
+			if      (delta > 0 && prior == 0) node->_gained();
+			else if (delta < 0 && prior == 1) detail::subscription_generation().fetch_add(1, std::memory_order_release);
+		}
+		if (accepts(flags::announce_receiver))
+			detail::announcement_listeners().fetch_add(size_t(ptrdiff_t(delta)), std::memory_order_seq_cst);
+	}
+
+	inline announcement_batch::~announcement_batch()
+	{
+		flush();
+		_current = _outer;
+	}
+
+	inline void announcement_batch::flush()
+	{
+		// Publish one announcement per topic.  Receivers registered meanwhile by callbacks are announced later.
+		auto publish_runs = [](auto &receivers)
+		{
+			using receiver_ptr = typename std::decay_t<decltype(receivers)>::value_type;
+			std::stable_sort(receivers.begin(), receivers.end(),
+				[](const receiver_ptr &a, const receiver_ptr &b) {return a->topic.path() < b->topic.path();});
+
+			for (auto first = receivers.begin(); first != receivers.end();)
+			{
+				auto last = std::find_if(first, receivers.end(),
+					[&](const receiver_ptr &r) {return r->topic.path() != (*first)->topic.path();});
+				(*first)->topic.publish(statuses::Created, std::vector<receiver_ptr>(first, last),
+					flags::announce_receiver | flags::recursive);
+				first = last;
+			}
+		};
+		std::vector<subscription_ptr> subscriptions;
+		std::vector<service_ptr>      services;
+		subscriptions.swap(_subscriptions);
+		services.swap(_services);
+		publish_runs(subscriptions);
+		publish_runs(services);
+	}
+
+	inline void consumer_group::_call(shared_subscription &member, const pleb::event &e)
+	{
+		try            {member.func(e);}
+		catch (...)    {member.topic._publish_exception(e, member, std::current_exception());}
+		member._outstanding.fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	inline bool latest_subscription::drain()
+	{
+		if (!(_middle.load(std::memory_order_relaxed) & _fresh)) return false;
+
+		_front = _middle.exchange(_front, std::memory_order_acq_rel) & _index;
+		try            {_consumer(*_slots[_front]);}
+		catch (...)    {topic._publish_exception(*_slots[_front], *this, std::current_exception());}
+		return true;
+	}
+
+	template<typename P>
+	void topic_<P>::fan_out(size_t min_subscribers)
+	{
+		auto &node = this->_realize();
+		if constexpr (type_can_be_null) null_topic_error::check(node, "can't fan out", "(null topic)");
+		node->set_fan_out(min_subscribers);
+	}
+
+	template<typename P> [[nodiscard]]
+	std::shared_ptr<retention> topic_<P>::retain(size_t max_topics)
+	{
+		auto &node = this->_realize();
+		if constexpr (type_can_be_null) null_topic_error::check(node, "can't retain", "(null topic)");
+
+		auto r = std::make_shared<retention>(node, max_topics);
+		node->set_retention(r);
+		return r;
+	}
+
+	template<typename P> [[nodiscard]]
+	std::shared_ptr<event_history> topic_<P>::record(size_t capacity)
+	{
+		auto &node = this->_realize();
+		if constexpr (type_can_be_null) null_topic_error::check(node, "can't record", "(null topic)");
+
+		auto h = std::make_shared<event_history>(node, capacity);
+		node->set_history(h);
+		return h;
+	}
+
+	template<typename P>
+	std::shared_ptr<const pleb::event> topic_<P>::retained() const noexcept
+	{
+		if constexpr (type_can_be_null) if (this->_is_null()) return nullptr;
+		const topic_<P> &target = base_t::_resolve();
+		return target._is_resolved() ? target._nearest_node()->retained() : nullptr;
+	}
+
 	template<typename P>
 	inline service_ptr topic_<P>::find_service(flags::filtering filtering) const noexcept
 	{
@@ -318,6 +1185,8 @@ namespace pleb
 		const topic_<P>  &target = base_t::_resolve();
 		resource_node_ptr node   = target._nearest_node();
 
+		if (!resource_data::served(node)) return service;
+
 		const bool recursive = (filtering & flags::recursive);
 		filtering &= ~flags::recursive;
 
@@ -332,6 +1201,7 @@ namespace pleb
 				if (service->accepts(filtering)) break;
 				service.reset();
 			}
+			else if ((service = node->group_lock(filtering))) break;
 			node = node->parent();
 		}
 
@@ -347,10 +1217,11 @@ namespace pleb
 		if constexpr (type_can_be_null)
 			null_topic_error::check(node, "can't publish event", "(null topic)");
 
+		size_t count = 0;
+		if (!resource_data::observed(node)) return count;
+
 		const bool recursive = (filtering & flags::recursive);
 		filtering = filtering & ~flags::recursive;
-		
-		size_t count = 0;
 
 		if (target._is_resolved()) goto start_resolved;
 
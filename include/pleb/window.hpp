@@ -0,0 +1,135 @@
+#pragma once
+
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <optional>
+
+#include "mailbox.hpp"
+#include "timer_wheel.hpp"
+
+/*
+	Windowed batch subscriptions; see topic::subscribe_batch with a batch_window.
+
+	Subscribers like database writers and network forwarders work best on
+		chunks of events.  A windowed subscription collects each event in a
+		lock-free ring and hands the batch subscriber a span of them once a
+		window's worth has arrived, or once the window's delay has passed
+		since its first event, whichever is sooner.
+
+	Windows are flushed on the default executor, one at a time.  Delays are
+		kept by the default timer wheel, so they are rounded up to its
+		resolution.  If four windows are waiting, publishers wait for room.
+*/
+
+
+namespace pleb
+{
+	/*
+		A subscription which delivers events in batches.
+	*/
+	class windowed_subscription : public subscription, private timer_wheel::timer
+	{
+	public:
+		const batch_window window;
+
+
+	public:
+		// Note this class will normally only be created by topic::subscribe_batch().
+		windowed_subscription(
+			const pleb::topic          &_topic,
+			batch_subscriber_function &&_func,
+			batch_window                _window,
+			subscription_config         flags = {})
+			:
+			subscription(_topic, [this](const pleb::event &e) {store(e);}, flags),
+			window(_window.events ? _window : batch_window{1, _window.delay}),
+			_consumer(std::move(_func)), _ring(4 * window.events) {_batch.reserve(window.events);}
+
+		~windowed_subscription()    {default_timer_wheel().cancel(*this);}
+
+		// Add an event to the current window.
+		void store(const pleb::event &e)
+		{
+			std::optional<pleb::event> item(std::in_place, e);
+			detail::own_content(*item);
+
+			// Count the event first, so pending() never falls below the events in the ring.
+			size_t n = _pending.fetch_add(1, std::memory_order_acq_rel) + 1;
+			while (!_ring.try_push(item))
+			{
+				// Help deliver a window rather than waiting on a worker.
+				if (!default_executor().running_in_this_thread() || !flush()) std::this_thread::yield();
+			}
+
+			if (n == 1)             default_timer_wheel().schedule(*this, timer_wheel::clock::now() + window.delay);
+			if (n == window.events) _schedule();
+		}
+
+		/*
+			Deliver up to one window of waiting events on this thread.
+				Returns the number delivered.  Delivery is never concurrent:
+				while another thread is flushing, this returns zero.
+		*/
+		size_t flush();
+
+		// Number of events waiting for their window to close.
+		size_t pending() const noexcept    {return _pending.load(std::memory_order_relaxed);}
+
+
+	private:
+		template<class P> friend class topic_;
+		const batch_subscriber_function                  _consumer;
+		detail::bounded_ring<std::optional<pleb::event>> _ring;
+		std::vector<pleb::event>                         _batch;     // Used while flushing.
+		std::atomic<size_t>                              _pending   = 0;
+		std::atomic<bool>                                _scheduled = false, _flushing = false;
+		std::weak_ptr<windowed_subscription>             _self;
+
+		// The window's delay has passed.
+		void expire() override    {_schedule();}
+
+		// Post a flush to the default executor unless one is waiting.
+		void _schedule()
+		{
+			if (_scheduled.load() || _scheduled.exchange(true)) return;
+
+			if (auto self = _self.lock())
+				default_executor().post([self = std::move(self)] {self->_flush_scheduled();});
+			else
+				_scheduled.store(false);
+		}
+
+		// Deliver every full window, then the rest once their delay passes.
+		void _flush_scheduled()
+		{
+			_scheduled.store(false);
+			while (flush() && pending() >= window.events) {}
+
+			if (pending()) default_timer_wheel().schedule(*this, timer_wheel::clock::now() + window.delay);
+		}
+	};
+
+
+	/*
+		Implementation of methods from the topic class.
+	*/
+	template<typename P> [[nodiscard]]
+	std::shared_ptr<windowed_subscription> topic_<P>::subscribe_batch(
+		batch_subscriber_function &&f,
+		batch_window                window,
+		subscription_config         flags)
+	{
+		auto &node = this->_realize();
+		if constexpr (type_can_be_null) null_topic_error::check(node, "can't subscribe", "(null topic)");
+
+		auto sub = std::make_shared<windowed_subscription>(topic(node), std::move(f), window, flags);
+		sub->_self = sub;
+		node->insert_subscriber(sub);
+		_announce(sub);
+		_replay_retained(node, sub);
+		return sub;
+	}
+}
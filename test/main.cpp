@@ -6,6 +6,7 @@
 #include <pleb/bind.hpp>
 #include <pleb/conversion_map.hpp>
 #include <pleb/pleb.hpp>
+#include <pleb/discover.hpp>
 //#include <pleb/resource.h>
 
 using namespace pleb::literals;
@@ -167,6 +168,561 @@ int main(int argc, char **argv)
 
 	}
 
+	{
+		// Await a service which responds inline, and one which defers its response.
+		auto svc_inline = pleb::serve("test/await/inline", [](pleb::request &r) {r.respond_OK(std::string("inline"));});
+		auto svc_later  = pleb::serve("test/await/later",  [](pleb::request &r)
+		{
+			std::thread([client = r.claim_client(), topic = r.topic]()
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				client->respond(topic, pleb::statuses::OK, std::string("later"));
+			}).detach();
+		});
+
+		std::cout << "Awaited: " << std::string(pleb::GET("test/await/inline")) << std::endl;
+		std::cout << "Awaited: " << std::string(pleb::GET("test/await/later"))  << std::endl;
+
+		pleb::request immediate(nullptr, "test/await/inline", pleb::method::GET, any(),
+			pleb::message_flags(pleb::flags::default_message_filtering, pleb::flags::immediate));
+		std::cout << "Awaited immediate: " << immediate.await<std::string>();
+		pleb::request deferred(nullptr, "test/await/later", pleb::method::GET, any(),
+			pleb::message_flags(pleb::flags::default_message_filtering, pleb::flags::immediate));
+		try                                   {deferred.await<std::string>(); std::cout << ", deferred answered" << std::endl;}
+		catch (pleb::handling_unavailable&)    {std::cout << ", deferred refused" << std::endl;}
+
+		// Fan out with pleb::future and join the results with a continuation.
+		std::vector<pleb::future<std::string>> fanout;
+		fanout.push_back(pleb::GET("test/await/inline"));
+		fanout.push_back(pleb::GET("test/await/later"));
+
+		std::promise<void> joined;
+		pleb::when_all(std::move(fanout)).then([&](pleb::future<std::vector<pleb::future<std::string>>> all)
+		{
+			for (auto &f : all.get()) std::cout << "Joined: " << f.get() << std::endl;
+			joined.set_value();
+		});
+		joined.get_future().wait();
+
+		// Await requests from a coroutine.
+		auto coroutine = []() -> pleb::task<std::string>
+		{
+			pleb::response r = co_await pleb::GET("test/await/inline");
+			std::string    s = co_await pleb::awaitable<std::string>(pleb::GET("test/await/later"));
+			co_return std::string(*r.get<std::string>()) + " then " + s;
+		}();
+		coroutine.start();
+		while (!coroutine.done()) std::this_thread::yield();
+		std::cout << "Coroutine: " << coroutine.get() << std::endl;
+
+		// A coroutine service which aggregates other services without blocking.
+		auto svc_aggregate = pleb::serve("test/await/aggregate", [](pleb::request &r) -> pleb::task<void>
+		{
+			std::string a = co_await pleb::awaitable<std::string>(pleb::GET("test/await/later"));
+			std::string b = co_await pleb::awaitable<std::string>(pleb::GET("test/await/inline"));
+			r.respond_OK(a + " and " + b);
+		});
+		std::cout << "Coroutine service: " << std::string(pleb::GET("test/await/aggregate")) << std::endl;
+
+		// A pooled service runs on the default executor.
+		auto svc_pooled = pleb::serve("test/pooled", [caller = std::this_thread::get_id()](pleb::request &r)
+		{
+			r.respond_OK(std::string(std::this_thread::get_id() == caller ? "caller's thread" : "executor"));
+		}, pleb::flags::pooled);
+		std::cout << "Pooled service ran on: " << std::string(pleb::GET("test/pooled")) << std::endl;
+
+		// Pooled services awaiting pooled services, with every worker busy, still finish.
+		auto svc_inner = pleb::serve("test/pooled/inner", [](pleb::request &r) {r.respond_OK(1);}, pleb::flags::pooled);
+		auto svc_outer = pleb::serve("test/pooled/outer", [](pleb::request &r)
+		{
+			r.respond_OK(pleb::GET("test/pooled/inner").await<int>() + 1);
+		}, pleb::flags::pooled);
+		std::vector<pleb::future<int>> nested;
+		for (size_t i = 0; i < 2 * pleb::default_executor().thread_count(); ++i) nested.push_back(pleb::GET("test/pooled/outer"));
+		int nested_sum = 0;
+		for (auto &f : nested) nested_sum += f.get();
+		std::cout << "Pooled nested awaits: " << (nested_sum == int(4 * pleb::default_executor().thread_count()) ? "finished" : "wrong") << std::endl;
+
+		// A service group balances requests among its instances.
+		std::vector<pleb::service_ptr> instances;
+		for (int i = 0; i < 3; ++i)
+			instances.push_back(pleb::serve_group("test/group", [i](pleb::request &r) {r.respond_OK(i);}));
+		std::cout << "Service group instances:";
+		for (int i = 0; i < 6; ++i) std::cout << " " << pleb::GET("test/group").await<int>();
+		std::cout << std::endl;
+
+		// Least outstanding counts requests claimed to answer later, until they are answered.
+		std::vector<pleb::client_ptr> deferred_work;
+		std::string                   chosen;
+		std::vector<pleb::service_ptr> balanced;
+		for (int i = 0; i < 2; ++i) balanced.push_back(pleb::serve_group("test/group/balanced", [&, i](pleb::request &r)
+		{
+			chosen += std::to_string(i);
+			if (i == 0) deferred_work.push_back(r.claim_client());
+			else        r.respond_OK(i);
+		}, {}, pleb::balancing::least_outstanding));
+		std::vector<pleb::future<int>> balanced_results;
+		for (int i = 0; i < 4; ++i) balanced_results.push_back(pleb::GET("test/group/balanced"));
+		std::cout << "Service group least outstanding: " << chosen << ", " << balanced[0]->outstanding() << " deferred";
+		for (auto &client : deferred_work) client->respond("test/group/balanced", pleb::statuses::OK, 0);
+		deferred_work.clear();
+		std::cout << ", then " << balanced[0]->outstanding() << std::endl;
+
+		// A single service and a group instance raced at one resource: only one kind may win.
+		int mixed = 0;
+		for (int round = 0; round < 100; ++round)
+		{
+			pleb::topic       contested("test/group/contested");
+			pleb::service_ptr single, grouped;
+			std::thread racer([&] {grouped = contested.serve_group([](pleb::request &r) {r.respond_OK(1);});});
+			single = contested.serve([](pleb::request &r) {r.respond_OK(0);});
+			racer.join();
+			mixed += (single && grouped);
+		}
+		std::cout << "Service group contested: " << mixed << " mixed" << std::endl;
+
+		// A partitioned service sends each user's requests to the same shard.
+		std::vector<pleb::service_function> shards;
+		for (int i = 0; i < 4; ++i) shards.push_back([i](pleb::request &r) {r.respond_OK(i);});
+		auto svc_users = pleb::serve_partitioned("test/users", std::move(shards));
+		for (auto path : {"test/users/alice", "test/users/bob", "test/users/alice/settings", "test/users/bob/friends/7"})
+			std::cout << "Partitioned " << std::setw(28) << std::left << path << std::right
+				<< " shard " << pleb::GET(path).await<int>() << std::endl;
+
+		// Issue a batch of requests; the batch service receives its share in one call.
+		auto svc_batch = pleb::serve_batch("test/batch", [](std::span<pleb::request> batch)
+		{
+			std::cout << "Batch service received " << batch.size() << " requests" << std::endl;
+			for (auto &r : batch) r.respond_OK(*r.get<int>() * 10);
+		});
+		std::vector<pleb::future<int>> batch_results(4);
+		std::vector<pleb::request>     batch;
+		for (int i = 0; i < 4; ++i)
+			batch.emplace_back(&batch_results[i], (i % 2) ? "test/batch" : "test/group", pleb::method::GET, i);
+		pleb::issue_batch(batch);
+		std::cout << "Batch results:";
+		for (auto &f : batch_results) std::cout << " " << f.get();
+
+		// The caller's requests keep their order, and a missing service is answered rather than thrown.
+		std::string order;
+		for (auto &r : batch) order += std::to_string(*r.get<int>());
+		pleb::future<pleb::response> missing;
+		std::vector<pleb::request>   lost;
+		lost.emplace_back(&missing, "nowhere/batch", pleb::method::GET);
+		pleb::issue_batch(lost);
+		std::cout << " (order " << order << ", missing " << int(missing.get().status().code) << ")" << std::endl;
+
+		const pleb::topic_path multi[] = {"test/await/inline", "test/await/later"};
+		std::cout << "Multi-topic GET:";
+		for (auto &f : pleb::get_batch<std::string>(multi)) std::cout << " " << f.get();
+		std::cout << std::endl;
+
+		// Identical GETs to a coalescing service share a single invocation.
+		std::atomic<int> invocations = 0;
+		auto svc_coalesce = pleb::serve("test/coalesce", [&](pleb::request &r)
+		{
+			++invocations;
+			std::thread([client = r.claim_client(), topic = r.topic]()
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				client->respond(topic, pleb::statuses::OK, std::string("shared"));
+			}).detach();
+		}, pleb::flags::coalescing);
+		std::vector<pleb::future<std::string>> herd;
+		for (int i = 0; i < 5; ++i) herd.push_back(pleb::GET("test/coalesce"));
+		std::cout << "Coalesced:";
+		for (auto &f : herd) std::cout << " " << f.get();
+		std::cout << " (" << invocations << " invocation)" << std::endl;
+	}
+
+	{
+		// A caching service is called again only after its topic changes.
+		int value = 1, invocations = 0;
+		auto svc_cache = pleb::serve("test/cache", [&](pleb::request &r)
+		{
+			if (r.method() == pleb::method::PUT) {value = *r.get<int>(); return;}
+			++invocations;
+			r.respond_OK(value);
+		}, pleb::flags::caching);
+
+		std::cout << "Cached:";
+		for (int i = 0; i < 3; ++i) std::cout << " " << int(pleb::GET("test/cache"));
+		pleb::PUT("test/cache", 2);
+		for (int i = 0; i < 3; ++i) std::cout << " " << int(pleb::GET("test/cache"));
+		value = 3;
+		pleb::publish("test/cache", pleb::statuses::OK);
+		for (int i = 0; i < 3; ++i) std::cout << " " << int(pleb::GET("test/cache"));
+		std::cout << " (" << invocations << " invocations)";
+
+		// A caching service may not claim an immediate request, which ends with the await.
+		auto svc_claims = pleb::serve("test/cache/claims", [](pleb::request &r)
+		{
+			auto client = r.claim_client();
+			client->respond(r.topic, pleb::statuses::OK, 5);
+		}, pleb::flags::caching);
+		pleb::request immediate(nullptr, "test/cache/claims", pleb::method::GET, any(),
+			pleb::message_flags(pleb::flags::default_message_filtering, pleb::flags::immediate));
+		try                                   {immediate.await<int>(); std::cout << ", immediate claimed" << std::endl;}
+		catch (pleb::handling_unavailable&)    {std::cout << ", immediate refused" << std::endl;}
+	}
+
+	{
+		// A deferred request times out at its deadline, even if the service holds the client.
+		std::vector<pleb::client_ptr> stalled;
+		bool within_budget = false;
+		auto svc_stall = pleb::serve("test/deadline", [&](pleb::request &r)
+		{
+			within_budget = (r.remaining() > std::chrono::milliseconds(0) && r.remaining() <= std::chrono::milliseconds(20));
+			stalled.push_back(r.claim_client());
+		});
+
+		auto began = std::chrono::steady_clock::now();
+		pleb::response timeout = pleb::topic("test/deadline").GET().set_timeout(std::chrono::milliseconds(20)).await();
+		auto waited = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - began);
+		std::cout << "Deadline: " << timeout.status() << (within_budget ? ", budget seen" : "")
+			<< ", waited " << (waited.count() >= 20 && waited.count() < 200 ? "about 20ms" : "wrong time") << std::endl;
+	}
+
+	{
+		// A long-poll service learns when its requesters give up.
+		std::vector<pleb::client_ptr> polls;
+		std::string                   noticed;
+		auto svc_poll = pleb::serve("test/long_poll", [&](pleb::request &r)
+		{
+			polls.push_back(r.claim_client());
+			polls.back()->on_cancel([&noticed] {noticed += " abandoned";});
+		});
+
+		{
+			pleb::future<int> dropped = pleb::GET("test/long_poll");
+		}
+		pleb::future<int> cancelled = pleb::GET("test/long_poll");
+		cancelled.cancel();
+
+		auto poller = [](pleb::topic t) -> pleb::task<int> {co_return co_await pleb::awaitable<int>(t.GET());};
+		auto task = poller("test/long_poll");
+		task.start();
+		task.cancel();
+		std::cout << "Cancelled:" << noticed << " (" << polls[0]->is_cancelled() << polls[1]->is_cancelled() << polls[2]->is_cancelled() << ")";
+
+		polls.back()->respond("test/long_poll", pleb::statuses::OK, 3);
+		polls.clear();
+		std::cout << ", task got " << task.get();
+
+		// A service which answers when cancelled resumes the task within cancel().
+		auto svc_quit = pleb::serve("test/quit", [&](pleb::request &r)
+		{
+			auto client = std::make_shared<pleb::client_ptr>(r.claim_client());
+			(*client)->on_cancel([client, topic = r.topic] {(*client)->respond(topic, pleb::statuses::OK, 4); client->reset();});
+		});
+		auto quitter = poller("test/quit");
+		quitter.start();
+		quitter.cancel();
+		std::cout << ", quitter got " << quitter.get() << std::endl;
+	}
+
+	{
+		// A service limited to one request at a time, with room for one more to wait.
+		pleb::topic                               limited("test/limited");
+		pleb::service_ptr                         svc_limited;
+		pleb::service_load                        seen = {};
+		std::vector<pleb::future<pleb::response>> nested;
+
+		svc_limited = limited.serve([&](pleb::request &r)
+		{
+			int n = *r.get<int>();
+			if (n == 0)
+			{
+				nested.push_back(limited.POST(1));
+				nested.push_back(limited.POST(2));
+				seen = svc_limited->load();
+			}
+			r.respond_OK(n);
+		});
+		svc_limited->set_limits({1, 1});
+
+		pleb::response first = limited.POST(0);
+		std::cout << "Admission: running " << seen.running << ", queued " << seen.queued << ", rejected " << seen.rejected << ";";
+		std::cout << " statuses " << first.status() << " " << nested[0].get().status() << " " << nested[1].get().status();
+
+		svc_limited->set_limits({0, 0}, [](pleb::request &r) {r.respond_OK(-1);});
+		std::cout << "; overflow answered " << int(limited.POST(5));
+
+		// A pooled service takes its turns without queueing.
+		auto svc_pooled = pleb::serve("test/limited/pooled", [](pleb::request &r) {r.respond_OK(7);}, pleb::flags::pooled);
+		svc_pooled->set_limits({4, 0});
+		pleb::response idle = pleb::GET("test/limited/pooled");
+		std::cout << "; pooled " << idle.status() << std::endl;
+	}
+
+	{
+		// Requests to a chain of relays reach the service at its end directly.
+		auto svc_v3 = pleb::serve("test/api/v3/echo", [](pleb::request &r)
+		{
+			r.respond_OK(std::string(r.topic.path()) + " for " + std::string(r.requested_topic().path()));
+		});
+		std::vector<pleb::service_relay_ptr> relays =
+		{
+			pleb::forward_requests("test/api/v2/echo", "test/api/v3/echo"),
+			pleb::forward_requests("test/api/v1/echo", "test/api/v2/echo"),
+			pleb::forward_requests("test/api/v0/echo", "test/api/v1/echo"),
+		};
+		std::cout << "Relayed: " << std::string(pleb::GET("test/api/v0/echo"));
+
+		auto loop_a = pleb::forward_requests("test/loop/a", "test/loop/b"), loop_b = pleb::forward_requests("test/loop/b", "test/loop/a");
+		std::cout << ", loop answered " << pleb::GET("test/loop/a").await().status() << std::endl;
+	}
+
+	{
+		// Event relays pass events on without copying their content.
+		struct payload
+		{
+			int *copies;
+			payload(int *c) : copies(c) {}
+			payload(const payload &o) : copies(o.copies) {++*copies;}
+		};
+		int         copies = 0;
+		std::string seen;
+		auto sub_b = pleb::subscribe("test/relay/b", [&](const pleb::event &e) {if (e.get<payload>()) seen += " " + std::string(e.topic.path());});
+		auto sub_c = pleb::subscribe("test/relay/c", [&](const pleb::event &e) {if (e.value_cast<payload>()) seen += " " + std::string(e.topic.path());});
+		auto relay_b = pleb::forward_events("test/relay/a", "test/relay/b", {}, pleb::event_forwarding::original_topic);
+		auto relay_c = pleb::forward_events("test/relay/b", "test/relay/c");
+
+		pleb::event e("test/relay/a", pleb::statuses::OK, payload(&copies));
+		copies = 0;
+		e.publish();
+		std::cout << "Forwarded:" << seen << " (" << copies << " copies)";
+
+		auto loop_a = pleb::forward_events("test/relay/loop/a", "test/relay/loop/b"), loop_b = pleb::forward_events("test/relay/loop/b", "test/relay/loop/a");
+		std::string caught;
+		auto on_error = [&](const pleb::event &e) {if (e.filtering & pleb::flags::subscriber_exception) caught = std::to_string(int(e.status().code));};
+		auto sub_error_a = pleb::subscribe("test/relay/loop/a", on_error, pleb::flags::announce_receiver);
+		auto sub_error_b = pleb::subscribe("test/relay/loop/b", on_error, pleb::flags::announce_receiver);
+		pleb::publish("test/relay/loop/a", pleb::statuses::OK, 1);
+		std::cout << ", loop stopped with " << caught << std::endl;
+	}
+
+	{
+		// Queued subscriptions receive events from a bounded mailbox, away from the publisher.
+		std::cout << "Queued:";
+		for (auto policy : {pleb::overflow_policy::drop_oldest, pleb::overflow_policy::drop_newest, pleb::overflow_policy::coalesce})
+		{
+			std::string got;
+			auto sub = pleb::subscribe_queued("test/queued", [&](const pleb::event &e) {got += std::to_string(*e.get<int>());},
+				pleb::mailbox_config{4, policy, true});
+			for (int i = 0; i < 10; ++i) pleb::publish("test/queued", pleb::statuses::OK, i);
+			sub->drain();
+			std::cout << " " << got << " (" << sub->dropped() << " dropped)";
+		}
+
+		std::atomic<int> delivered = 0;
+		bool             off_thread = true;
+		auto sub_block = pleb::subscribe_queued("test/queued", [&, caller = std::this_thread::get_id()](const pleb::event&)
+		{
+			if (std::this_thread::get_id() == caller) off_thread = false;
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+			++delivered;
+		}, pleb::mailbox_config{4, pleb::overflow_policy::block});
+		for (int i = 0; i < 10; ++i) pleb::publish("test/queued", pleb::statuses::OK, i);
+		while (delivered < 10) std::this_thread::yield();
+		std::cout << "; blocking mailbox delivered " << delivered << (off_thread ? " on the executor" : " on the publisher") << std::endl;
+	}
+
+	{
+		// Latest-value subscriptions keep only the newest event for a slow consumer.
+		auto                                                    meters = std::make_shared<pleb::conflation_group>();
+		std::vector<std::shared_ptr<pleb::latest_subscription>> subs;
+		std::string                                             shown;
+		for (auto path : {"test/meters/left", "test/meters/right", "test/meters/master"})
+			subs.push_back(pleb::subscribe_latest(path, [&](const pleb::event &e)
+			{
+				shown += " " + std::string(e.topic.id()) + "=" + std::to_string(*e.get<int>());
+			}, meters));
+
+		for (int i = 0; i <= 100; ++i)
+		{
+			pleb::publish("test/meters/left",  pleb::statuses::OK, i);
+			pleb::publish("test/meters/right", pleb::statuses::OK, 2 * i);
+		}
+		// Content borrowed through a relay is copied, so it outlives the publish.
+		auto relay = pleb::forward_events("test/meters/bus", "test/meters/master", {}, pleb::event_forwarding::destination_topic);
+		pleb::publish("test/meters/bus", pleb::statuses::OK, 7);
+		size_t first = meters->drain(), second = meters->drain();
+		std::cout << "Latest:" << shown << " (" << first << " then " << second << " delivered, "
+			<< subs[0]->conflated() << " conflated)" << std::endl;
+	}
+
+	{
+		// Retained events reach late subscribers at once, within a bounded subtree.
+		auto retained = pleb::retain("test/retained", 2);
+		pleb::publish("test/retained/a", pleb::statuses::OK, 1);
+		pleb::publish("test/retained/a", pleb::statuses::OK, 2);
+		pleb::publish("test/retained/b", pleb::statuses::OK, 3);
+		pleb::publish("test/retained/c", pleb::statuses::OK, 4);
+
+		std::string late, whole;
+		auto sub_a   = pleb::subscribe("test/retained/a", [&](const pleb::event &e) {late  += std::to_string(*e.get<int>());});
+		auto sub_all = pleb::subscribe("test/retained",   [&](const pleb::event &e) {whole += std::to_string(*e.get<int>());});
+		std::sort(whole.begin(), whole.end());
+		auto value = pleb::topic("test/retained/b").retained();
+		std::cout << "Retained: a=" << late << " subtree=" << whole << " b=" << (value ? *value->get<int>() : 0)
+			<< " (" << retained->size() << " kept, " << retained->refused() << " refused)";
+		retained.reset();
+		std::cout << "; released: " << (pleb::topic("test/retained/a").retained() ? "kept" : "forgotten");
+
+		// Clearing while publishing leaves nothing retained that the retention doesn't count.
+		pleb::topic       raced("test/retained/raced");
+		auto              racing = pleb::retain("test/retained/raced", 1);
+		std::atomic<bool> stop   = false;
+		std::thread publisher([&] {for (int i = 0; !stop; ++i) raced.publish(pleb::statuses::OK, i);});
+		for (int i = 0; i < 20000; ++i) racing->clear();
+		stop = true;
+		publisher.join();
+		racing->clear();
+		std::cout << "; raced clear: " << (raced.retained() ? "stale" : "clean") << std::endl;
+	}
+
+	{
+		// An event history records a subtree's recent events for replay.
+		auto history = pleb::record("test/history", 4);
+		for (int i = 0; i < 6; ++i) pleb::publish(i % 2 ? "test/history/b" : "test/history/a", pleb::statuses::OK, i);
+
+		std::string recorded, a, all;
+		history->replay(0, [&](const pleb::event &e, const pleb::topic_path &t) {recorded += " " + std::string(t.id()) + std::to_string(*e.get<int>());});
+		auto sub_a   = pleb::topic("test/history/a").subscribe_replay(*history, 0,                  [&](const pleb::event &e) {a   += std::to_string(*e.get<int>());});
+		auto sub_all = pleb::topic("test/history")  .subscribe_replay(*history, history->next() - 3, [&](const pleb::event &e) {all += std::to_string(*e.get<int>());});
+		pleb::publish("test/history/a", pleb::statuses::OK, 6);
+		std::cout << "History:" << recorded << "; replayed a=" << a << " from " << history->oldest() << ", all=" << all << " (next " << history->next() << ")" << std::endl;
+	}
+
+	{
+		// A batch is delivered over one walk of the subscribers; batch subscribers take it in one call.
+		std::string batches, singles, parent;
+		auto sub_batch  = pleb::topic("test/batch/sensor").subscribe_batch([&](std::span<const pleb::event> events)
+		{
+			batches += " [";
+			for (auto &e : events) batches += std::to_string(*e.get<int>());
+			batches += "]";
+		});
+		auto sub_single = pleb::subscribe("test/batch/sensor", [&](const pleb::event &e) {singles += std::to_string(*e.get<int>());});
+		auto sub_parent = pleb::subscribe("test/batch",        [&](const pleb::event &e) {parent  += std::to_string(*e.get<int>());});
+
+		pleb::topic("test/batch/sensor").publish_batch(pleb::statuses::OK, std::vector<int>{1, 2, 3});
+
+		std::vector<pleb::event> events;
+		for (int i = 4; i <= 6; ++i) events.emplace_back("test/batch/sensor", pleb::statuses::OK, i, i == 5 ? pleb::flags::regular : pleb::flags::default_message_filtering);
+		pleb::topic("test/batch/sensor").publish_batch(events);
+		pleb::publish("test/batch/sensor", pleb::statuses::OK, 7);
+		std::cout << "Batch:" << batches << ", singly " << singles << ", parent " << parent << std::endl;
+	}
+
+	{
+		// Windowed subscriptions receive events in batches, once a window fills or its delay passes.
+		std::atomic<size_t> delivered = 0, largest = 0;
+		auto sub = pleb::topic("test/window").subscribe_batch([&](std::span<const pleb::event> events)
+		{
+			largest = std::max<size_t>(largest, events.size());
+			delivered += events.size();
+		}, pleb::batch_window{4, std::chrono::milliseconds(2)});
+
+		for (int i = 0; i < 10; ++i) pleb::publish("test/window", pleb::statuses::OK, i);
+		while (delivered < 10) std::this_thread::yield();
+		std::cout << "Windowed: delivered " << delivered << " in batches of at most " << largest
+			<< " (" << sub->pending() << " pending)" << std::endl;
+	}
+
+	{
+		// Topics with many subscribers may fan events out across the executor's workers.
+		pleb::topic                         topic("test/fan_out");
+		std::atomic<int>                    received = 0, queued = 0;
+		std::vector<pleb::subscription_ptr> subs;
+		for (int i = 0; i < 200; ++i) subs.push_back(topic.subscribe([&](const pleb::event &e) {received += *e.get<int>();}));
+		auto sub_queued = topic.subscribe_queued([&](const pleb::event &e) {queued += *e.get<int>();}, pleb::mailbox_config{16, pleb::overflow_policy::block, true});
+
+		topic.fan_out(64);
+		for (int i = 1; i <= 3; ++i) topic.publish(pleb::statuses::OK, i);
+		sub_queued->drain();
+
+		// Once most subscribers leave, events are delivered serially again.
+		subs.resize(2);
+		const auto publisher = std::this_thread::get_id();
+		bool       serial    = true;
+		subs.push_back(topic.subscribe([&](const pleb::event&) {serial = (std::this_thread::get_id() == publisher);}));
+		for (int i = 0; i < 8; ++i) topic.publish(pleb::statuses::OK, 0);
+		std::cout << "Fan-out: " << received << " received in parallel, " << queued << " queued, "
+			<< (serial ? "serial" : "parallel") << " after unsubscribing" << std::endl;
+	}
+
+	{
+		// Members of a consumer group share its events, each event reaching one member.
+		pleb::topic                                            topic("test/shared");
+		std::string                                            got[3], all;
+		std::vector<std::shared_ptr<pleb::shared_subscription>> members;
+		for (int m = 0; m < 3; ++m)
+			members.push_back(topic.subscribe_shared("workers", [&, m](const pleb::event &e) {got[m] += std::to_string(*e.get<int>());}));
+		auto sub_all = topic.subscribe([&](const pleb::event &e) {all += std::to_string(*e.get<int>());});
+
+		for (int i = 0; i < 6; ++i) topic.publish(pleb::statuses::OK, i);
+		members[1].reset();
+		for (int i = 6; i < 10; ++i) topic.publish(pleb::statuses::OK, i);
+		members.clear();
+		sub_all.reset();
+
+		// Members joining at once each publish straight away; every event must reach the group.
+		std::atomic<int>         delivered = 0;
+		std::vector<std::thread> joiners;
+		for (int m = 0; m < 8; ++m) joiners.emplace_back([&]
+		{
+			auto member = topic.subscribe_shared("racers", [&](const pleb::event&) {++delivered;});
+			topic.publish(pleb::statuses::OK, 0);
+		});
+		for (auto &j : joiners) j.join();
+		auto rejoined = topic.subscribe_shared("workers", [](const pleb::event&) {});
+
+		std::cout << "Shared: " << got[0] << " " << got[1] << " " << got[2] << ", broadcast " << all
+			<< " (" << rejoined->group->size() << " member after rejoining, " << delivered << "/8 raced)" << std::endl;
+	}
+
+	{
+		// Topics nobody observes are skipped cheaply, until a receiver appears above them.
+		pleb::topic app("test/unobserved"), debug("test/unobserved/debug/trace");
+		auto state = [&] {return std::to_string(debug.count_subscriptions()) + (app.find_service() ? "s" : "");};
+
+		std::string seen = state();
+		auto sub = app.subscribe([](const pleb::event&) {});
+		auto svc = app.serve([](pleb::request &r) {r.respond(pleb::statuses::OK);});
+		seen += " " + state();
+		sub.reset(); svc.reset();
+		seen += " " + state();
+		std::cout << "Unobserved: " << seen << std::endl;
+	}
+
+	{
+		// Receivers registered within a batch are announced together, once per topic, or not at all.
+		size_t found = 0, announcements = 0;
+		std::vector<pleb::subscription_ptr> subs;
+		auto watch = pleb::discover_subscriptions([&](const pleb::subscription_ptr&) {++found;}, pleb::topic("test/announce"));
+		auto count = pleb::subscribe("test/announce", [&](const pleb::event &e) {announcements += bool(e.filtering & pleb::flags::announce_receiver);}, pleb::flags::regular);
+		auto add   = [&](const char *path) {subs.push_back(pleb::subscribe(path, [](const pleb::event&) {}));};
+		found = announcements = 0;
+
+		std::string seen;
+		{
+			pleb::announcement_batch batch;
+			for (int i = 0; i < 3; ++i) add("test/announce/a");
+			for (int i = 0; i < 2; ++i) add("test/announce/b");
+			seen += std::to_string(found) + " pending " + std::to_string(batch.size());
+		}
+		seen += ", " + std::to_string(found) + " in " + std::to_string(announcements);
+		{
+			pleb::announcement_batch batch(pleb::announcement_batch::suppress);
+			for (int i = 0; i < 3; ++i) add("test/announce/c");
+		}
+		add("test/announce/d");
+		seen += ", " + std::to_string(found) + " in " + std::to_string(announcements);
+		std::cout << "Announced: " << seen << std::endl;
+	}
+
 	//test_pool = test_pool_t::create();
 	std::string_view test_strings[] =
 	{